@@ -1,43 +1,221 @@
 #include "include/esp_wav_player.h"
 #include <string.h>
+#include <math.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_idf_version.h>
 #include "wav_handle.h"
+#include "wav_conv.h"
+
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+// handler instances keep one registration per player; older IDFs share one registration
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
+#define WAV_EVENT_INSTANCES 1
+#endif
 
 #define WAV_BUF_SIZE 1024
+#define WAV_CHUNK_MIN 256
+
+#define WAV_SCHED_MARGIN_US 5000
+#define SEQ_READ_SPINS 64
+#define SEQ_READ_TRIES 8
+#define GAIN_SHIFT   8
+#define GAIN_UNITY   (1 << GAIN_SHIFT)
+#define XFADE_SHIFT  12
+
+// keeps the Q12 conversion products within 32 bits
+#define CLIP_GAIN_MAX_DB 12.0f
+
+ESP_EVENT_DEFINE_BASE(ESP_WAV_PLAYER_EVENT);
 
 static const char *TAG = "WAV";
 static void        wav_player_task(void *arg);
 
-struct esp_wav_player {
-    QueueHandle_t queue;
-    TaskHandle_t  task;
+typedef struct {
+    const wav_dsp_stage_t *stage;
+    void                  *ctx;
+} wav_dsp_slot_t;
 
-    i2s_config_t     base_cfg;
-    i2s_pin_config_t pins;
+typedef struct {
     int              i2s_num;
+    i2s_pin_config_t pins;
+    volatile int32_t gain;     /* Q8, GAIN_UNITY writes the shared buffer as is */
+    uint32_t         delay_us; /* leading silence at track start */
+    size_t           done;     /* bytes of the pending audio already taken */
+} wav_zone_t;
+
+typedef struct {
+    int64_t  frames;   /* track frames written to I2S, reset when the track's first sample is written */
+    int64_t  drain_at; /* time the written frames run out */
+    uint32_t rate;     /* sample rate, 0 when no track is playing */
+} wav_clock_t;
+
+typedef struct {
+    uint32_t avg_us;  /* EWMA of read call latency */
+    uint32_t peak_us; /* worst read latency, decays per track */
+    uint32_t load_q8; /* EWMA of read time / audio time, Q8 */
+} wav_latency_t;
+
+typedef struct {
+    wav_handle_t *h;
+    int32_t       gain;
+    bool          metering;
+    wav_conv_fn_t conv;
+    int32_t       conv_gain[2];
+    bool          direct;     /* already in the sink format, written to I2S straight from the source */
+    size_t        read_max;   /* source bytes per read that still fit the buffer once converted */
+    size_t        bytes_left; /* not yet read from the source */
+    size_t        bytes_done; /* output bytes accepted by I2S */
+    size_t        progress_step;
+    size_t        progress_at;
+} wav_track_t;
+
+struct esp_wav_player {
+    QueueHandle_t         queue;
+    TaskHandle_t          task;
+    esp_wav_player_mode_t mode;
+
+    i2s_config_t base_cfg;
+    int          out_ch;    /* sink channels, samples are always 16-bit */
+    size_t       out_align; /* bytes per sink frame */
+
+    /* every zone writes the same pending audio, each at its own pace */
+    wav_zone_t zones[ESP_WAV_PLAYER_MAX_ZONES];
+    size_t     num_zones;
+    bool       zone_delays;
+
+    /* idle policy: clocks stopped and light sleep allowed between tracks */
+    uint32_t idle_stop_ms;
+    bool     idle;
+    int64_t  idle_since;
+    int64_t  wake_at; /* set on wake-up until the first sample is written */
+    uint32_t idle_stops;
+    uint32_t wake_us;
+    uint32_t wake_max_us;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock;
+#endif
 
     volatile esp_wav_player_state_t state;
     volatile bool                   stop_request;
     volatile bool                   pause_request;
 
     uint8_t volume;
+    bool    metering;
+
+    /* seqlock protected: odd meter_seq means an update is in progress */
+    volatile uint32_t      meter_seq;
+    esp_wav_player_meter_t meter;
+
+    /* seqlock protected playback clock, written by the output path */
+    volatile uint32_t clock_seq;
+    wav_clock_t       clock;
 
     esp_wav_player_cb_t on_start;
     esp_wav_player_cb_t on_end;
 
     void *on_start_arg;
     void *on_end_arg;
+
+    esp_event_loop_handle_t event_loop;
+    bool                    cb_registered;
+#ifdef WAV_EVENT_INSTANCES
+    esp_event_handler_instance_t cb_instance;
+#endif
+    uint32_t                progress_interval_ms;
+
+    /* time the queued audio runs out, 0 when not playing */
+    int64_t  drain_at;
+    int64_t  start_us;
+    int64_t  dma_depth_us;
+    uint32_t underruns;
+    uint32_t track_underruns;
+
+    wav_dsp_slot_t stages[ESP_WAV_PLAYER_MAX_STAGES];
+    size_t         num_stages;
+
+    /* stages validated for the current track */
+    wav_dsp_slot_t active[ESP_WAV_PLAYER_MAX_STAGES];
+    size_t         num_active;
+
+    wav_track_t track;
+    /* source type of the current track, WAV_SRC_MAX when none; read by other tasks instead of track.h */
+    volatile wav_source_type_t track_type;
+
+    bool          adaptive;
+    int           dma_buf_count_max;
+    size_t        chunk_size;
+    wav_latency_t latency[WAV_SRC_MAX];
+
+    /* processed audio in pend[0..pend_len) not yet taken by I2S, in buf or mapped source data */
+    uint8_t       *buf;
+    size_t         buf_size;
+    const uint8_t *pend;
+    size_t         pend_len;
+
+    /* crossfade: next track opened ahead, raw audio in xbuf[xoff..xoff + xlen) */
+    uint32_t    crossfade_ms;
+    wav_track_t next;
+    bool        next_mix; /* same format as the current track, will be mixed in */
+    size_t      xfade_len;
+    uint32_t    xfade_step;
+    uint8_t    *xbuf;
+    size_t      xoff;
+    size_t      xlen;
 };
 
+static void player_cb_unregister(struct esp_wav_player *player);
+
+static int32_t zone_gain(float gain_db)
+{
+    return gain_db < 0 ? (int32_t)lrintf(GAIN_UNITY * powf(10.0f, gain_db / 20.0f)) : GAIN_UNITY;
+}
+
+static void zones_install(struct esp_wav_player *player)
+{
+    for (size_t i = 0; i < player->num_zones; i++) {
+        i2s_driver_install(player->zones[i].i2s_num, &player->base_cfg, 0, NULL);
+        i2s_set_pin(player->zones[i].i2s_num, &player->zones[i].pins);
+    }
+}
+
+static void zones_uninstall(struct esp_wav_player *player)
+{
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_driver_uninstall(player->zones[i].i2s_num);
+}
+
 esp_err_t esp_wav_player_init(esp_wav_player_t *hdl, const esp_wav_player_config_t *cfg)
 {
-    if (!hdl || !cfg)
+    if (!hdl || !cfg || cfg->num_zones > ESP_WAV_PLAYER_MAX_ZONES)
         return ESP_ERR_INVALID_ARG;
 
-    struct esp_wav_player *player = calloc(1, sizeof(*player));
+    // every track is converted to this layout, so I2S is configured once
+    if (cfg->base_cfg.bits_per_sample != 16) {
+        ESP_LOGE(TAG, "output must be 16-bit");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    size_t buf_size = cfg->buf_size ? cfg->buf_size : WAV_BUF_SIZE;
+    int    num_bufs = cfg->crossfade_ms ? 2 : 1;
+
+    // player and its buffers in a single allocation
+    struct esp_wav_player *player = calloc(1, sizeof(*player) + num_bufs * buf_size);
     if (!player)
         return ESP_ERR_NO_MEM;
 
+    player->buf = (uint8_t *)(player + 1);
+    player->buf_size = buf_size;
+    if (cfg->crossfade_ms) {
+        player->crossfade_ms = cfg->crossfade_ms;
+        player->xbuf = player->buf + buf_size;
+    }
+    player->chunk_size = buf_size;
+    player->mode = cfg->mode;
+
     player->queue = xQueueCreate(cfg->queue_len, sizeof(wav_handle_t *));
     if (!player->queue) {
         free(player);
@@ -46,15 +224,51 @@ esp_err_t esp_wav_player_init(esp_wav_player_t *hdl, const esp_wav_player_config
 
     player->volume = 100;
     player->state = ESP_WAV_PLAYER_STOPPED;
+    player->track_type = WAV_SRC_MAX;
 
-    player->i2s_num = cfg->i2s_num;
-    player->pins = cfg->i2s_pin_config;
     player->base_cfg = cfg->base_cfg;
+    if (cfg->num_zones) {
+        for (size_t i = 0; i < cfg->num_zones; i++) {
+            wav_zone_t *z = &player->zones[i];
 
-    i2s_driver_install(player->i2s_num, &player->base_cfg, 0, NULL);
-    i2s_set_pin(player->i2s_num, &player->pins);
+            z->i2s_num = cfg->zones[i].i2s_num;
+            z->pins = cfg->zones[i].i2s_pin_config;
+            z->gain = zone_gain(cfg->zones[i].gain_db);
+            z->delay_us = cfg->zones[i].delay_us;
+            if (z->delay_us)
+                player->zone_delays = true;
+        }
+        player->num_zones = cfg->num_zones;
+    } else {
+        player->zones[0].i2s_num = cfg->i2s_num;
+        player->zones[0].pins = cfg->i2s_pin_config;
+        player->zones[0].gain = GAIN_UNITY;
+        player->num_zones = 1;
+    }
+    player->out_ch = (cfg->base_cfg.channel_format == I2S_CHANNEL_FMT_ONLY_LEFT ||
+                      cfg->base_cfg.channel_format == I2S_CHANNEL_FMT_ONLY_RIGHT)
+                         ? 1
+                         : 2;
+    player->out_align = player->out_ch * sizeof(int16_t);
+    player->event_loop = cfg->event_loop;
+    player->progress_interval_ms = cfg->progress_interval_ms;
+    player->adaptive = cfg->adaptive_buffering;
+    player->dma_buf_count_max = cfg->dma_buf_count_max ? cfg->dma_buf_count_max : 2 * cfg->base_cfg.dma_buf_count;
+
+    zones_install(player);
+
+    // I2S runs from here on: no light sleep until the output goes idle
+    player->idle_stop_ms = cfg->idle_stop_ms;
+    player->idle_since = esp_timer_get_time();
+#if CONFIG_PM_ENABLE
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "wav_player", &player->pm_lock) == ESP_OK)
+        esp_pm_lock_acquire(player->pm_lock);
+    else
+        player->pm_lock = NULL;
+#endif
 
-    xTaskCreate(wav_player_task, "wav_player_task", 4096, player, 5, &player->task);
+    if (player->mode == ESP_WAV_PLAYER_MODE_TASK)
+        xTaskCreate(wav_player_task, "wav_player_task", 4096, player, 5, &player->task);
 
     *hdl = player;
     return ESP_OK;
@@ -70,18 +284,43 @@ esp_err_t esp_wav_player_deinit(esp_wav_player_t hdl)
     // Tell task to exit
     player->state = ESP_WAV_PLAYER_STOPPED;
 
-    // Wake the task in case it's blocking on queue
-    wav_handle_t *dummy = NULL;
-    xQueueSend(player->queue, &dummy, 0);
-
     // Wait for the task to exit
     if (player->task) {
+        // Wake the task in case it's blocking on queue
+        wav_handle_t *dummy = NULL;
+        xQueueSend(player->queue, &dummy, 0);
+
         vTaskDelete(player->task);
         player->task = NULL;
     }
 
-    // Uninstall I2S driver
-    i2s_driver_uninstall(player->i2s_num);
+    // Release the track being played and anything still queued
+    if (player->track.h) {
+        player->track.h->close(player->track.h);
+        wav_handle_free(player->track.h);
+        player->track.h = NULL;
+    }
+    if (player->next.h) {
+        player->next.h->close(player->next.h);
+        wav_handle_free(player->next.h);
+        player->next.h = NULL;
+    }
+    for (wav_handle_t *h; xQueueReceive(player->queue, &h, 0) == pdTRUE;) {
+        if (h)
+            wav_handle_free(h);
+    }
+
+    player_cb_unregister(player);
+
+    // Uninstall I2S drivers
+    zones_uninstall(player);
+#if CONFIG_PM_ENABLE
+    if (player->pm_lock) {
+        if (!player->idle)
+            esp_pm_lock_release(player->pm_lock);
+        esp_pm_lock_delete(player->pm_lock);
+    }
+#endif
 
     // Delete queue
     if (player->queue) {
@@ -104,7 +343,32 @@ esp_err_t esp_wav_player_play(esp_wav_player_t hdl, const wav_obj_t *src)
     if (!h)
         return ESP_FAIL;
 
-    return xQueueSend(player->queue, &h, 0) == pdTRUE ? ESP_OK : ESP_FAIL;
+    if (xQueueSend(player->queue, &h, 0) != pdTRUE) {
+        wav_handle_free(h);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_player_play_at(esp_wav_player_t hdl, const wav_obj_t *src, int64_t start_us)
+{
+    if (!hdl || !src)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    if (player->mode != ESP_WAV_PLAYER_MODE_TASK)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    wav_handle_t *h = wav_handle_init(src);
+    if (!h)
+        return ESP_FAIL;
+
+    h->start_at = start_us;
+    if (xQueueSend(player->queue, &h, 0) != pdTRUE) {
+        wav_handle_free(h);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
 }
 
 esp_err_t esp_wav_player_stop(esp_wav_player_t hdl)
@@ -157,16 +421,119 @@ esp_err_t esp_wav_player_get_volume(esp_wav_player_t hdl, uint8_t *vol)
     return ESP_OK;
 }
 
+esp_err_t esp_wav_player_get_power(esp_wav_player_t hdl, esp_wav_player_power_t *info)
+{
+    if (!hdl || !info)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    info->idle = player->idle;
+    info->idle_stops = player->idle_stops;
+    info->wake_us = player->wake_us;
+    info->wake_max_us = player->wake_max_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_player_set_zone_gain(esp_wav_player_t hdl, size_t zone, float gain_db)
+{
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+
+    if (!player || zone >= player->num_zones)
+        return ESP_ERR_INVALID_ARG;
+
+    player->zones[zone].gain = zone_gain(gain_db);
+    return ESP_OK;
+}
+
 esp_err_t esp_wav_player_get_queued(esp_wav_player_t hdl, size_t *qlen)
 {
     if (!hdl || !qlen)
         return ESP_ERR_INVALID_ARG;
 
     struct esp_wav_player *player = (struct esp_wav_player *)hdl;
-    *qlen = uxQueueMessagesWaiting(player->queue);
+    *qlen = uxQueueMessagesWaiting(player->queue) + (player->next.h ? 1 : 0);
     return ESP_OK;
 }
 
+// runs in the event loop task, so user callbacks never execute on the audio path
+static void player_cb_dispatch(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const esp_wav_player_event_data_t *ev = data;
+    struct esp_wav_player             *player;
+
+    if (!ev)
+        return;
+#ifdef WAV_EVENT_INSTANCES
+    player = arg;
+    if (ev->player != player)
+        return;
+#else
+    player = ev->player;
+#endif
+
+    if (id == ESP_WAV_PLAYER_EVENT_START && player->on_start)
+        player->on_start(player, player->on_start_arg);
+    else if (id == ESP_WAV_PLAYER_EVENT_END && player->on_end)
+        player->on_end(player, player->on_end_arg);
+}
+
+#ifndef WAV_EVENT_INSTANCES
+/* registering the same handler again would only replace its arg, so players share one registration */
+static int cb_users;
+#endif
+
+static void player_cb_register(struct esp_wav_player *player)
+{
+    esp_err_t rc = ESP_OK;
+
+    if (player->cb_registered)
+        return;
+
+#ifdef WAV_EVENT_INSTANCES
+    if (player->event_loop)
+        rc = esp_event_handler_instance_register_with(player->event_loop, ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID,
+                                                      player_cb_dispatch, player, &player->cb_instance);
+    else
+        rc = esp_event_handler_instance_register(ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID, player_cb_dispatch, player,
+                                                 &player->cb_instance);
+#else
+    if (player->event_loop)
+        rc = esp_event_handler_register_with(player->event_loop, ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID,
+                                             player_cb_dispatch, NULL);
+    else if (!cb_users)
+        rc = esp_event_handler_register(ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID, player_cb_dispatch, NULL);
+    if (rc == ESP_OK && !player->event_loop)
+        cb_users++;
+#endif
+
+    if (rc == ESP_OK)
+        player->cb_registered = true;
+    else
+        ESP_LOGE(TAG, "event handler register failed: %s", esp_err_to_name(rc));
+}
+
+static void player_cb_unregister(struct esp_wav_player *player)
+{
+    if (!player->cb_registered)
+        return;
+
+#ifdef WAV_EVENT_INSTANCES
+    if (player->event_loop)
+        esp_event_handler_instance_unregister_with(player->event_loop, ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID,
+                                                   player->cb_instance);
+    else
+        esp_event_handler_instance_unregister(ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID, player->cb_instance);
+#else
+    // a private loop is not shared with other players
+    if (player->event_loop)
+        esp_event_handler_unregister_with(player->event_loop, ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID,
+                                          player_cb_dispatch);
+    else if (--cb_users == 0)
+        esp_event_handler_unregister(ESP_WAV_PLAYER_EVENT, ESP_EVENT_ANY_ID, player_cb_dispatch);
+#endif
+    player->cb_registered = false;
+}
+
 void esp_wav_player_set_start_cb(esp_wav_player_t hdl, esp_wav_player_cb_t cb, void *arg)
 {
     if (!hdl)
@@ -175,6 +542,8 @@ void esp_wav_player_set_start_cb(esp_wav_player_t hdl, esp_wav_player_cb_t cb, v
     struct esp_wav_player *player = (struct esp_wav_player *)hdl;
     player->on_start = cb;
     player->on_start_arg = arg;
+    if (cb)
+        player_cb_register(player);
 }
 
 void esp_wav_player_set_end_cb(esp_wav_player_t hdl, esp_wav_player_cb_t cb, void *arg)
@@ -185,91 +554,1052 @@ void esp_wav_player_set_end_cb(esp_wav_player_t hdl, esp_wav_player_cb_t cb, voi
     struct esp_wav_player *player = (struct esp_wav_player *)hdl;
     player->on_end = cb;
     player->on_end_arg = arg;
+    if (cb)
+        player_cb_register(player);
 }
 
-static void wav_player_task(void *arg)
+// never blocks: an event is dropped rather than stalling the audio task
+static void player_post(struct esp_wav_player *player, esp_wav_player_event_t id, const wav_handle_t *wavh,
+                        size_t bytes_done, esp_err_t error)
 {
-    struct esp_wav_player *player = arg;
-    wav_handle_t          *wavh = NULL;
+    esp_wav_player_event_data_t ev = {
+        .player = player,
+        .error = error,
+        .start_us = player->start_us,
+    };
+    esp_err_t rc;
 
-    uint8_t buf[WAV_BUF_SIZE];
-    size_t  i2s_wr;
-    while (1) {
-        if (!xQueueReceive(player->queue, &wavh, portMAX_DELAY))
+    if (wavh && wavh->sample_rate) {
+        ev.position_ms = (uint64_t)(bytes_done / player->out_align) * 1000 / wavh->sample_rate;
+        ev.duration_ms = (uint64_t)(wavh->data_bytes / wavh->sample_alignment) * 1000 / wavh->sample_rate;
+    }
+
+    if (player->event_loop)
+        rc = esp_event_post_to(player->event_loop, ESP_WAV_PLAYER_EVENT, id, &ev, sizeof(ev), 0);
+    else
+        rc = esp_event_post(ESP_WAV_PLAYER_EVENT, id, &ev, sizeof(ev), 0);
+
+    if (rc != ESP_OK)
+        ESP_LOGD(TAG, "event %d dropped: %s", id, esp_err_to_name(rc));
+}
+
+/*
+ * Seqlock helpers: the player task is the only writer, readers in other tasks
+ * retry instead of blocking it. An odd sequence marks an update in progress.
+ */
+static inline uint32_t seq_write_begin(volatile uint32_t *seq)
+{
+    uint32_t s = *seq;
+
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return s;
+}
+
+static inline void seq_write_end(volatile uint32_t *seq, uint32_t s)
+{
+    __atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
+
+static inline bool seq_read_retry(volatile uint32_t *seq, uint32_t s)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != s;
+}
+
+/*
+ * Copy `len` bytes published under `seq`. On a single core a reader that
+ * preempted the writer mid-update would spin forever, so after a short spin
+ * it sleeps a tick to let the writer finish, and gives up after
+ * SEQ_READ_TRIES attempts.
+ */
+static esp_err_t seq_read(volatile uint32_t *seq, void *dst, const void *src, size_t len)
+{
+    for (int i = 0; i < SEQ_READ_TRIES; i++) {
+        uint32_t s;
+        int      spin = 0;
+
+        while ((s = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1 && ++spin < SEQ_READ_SPINS)
+            ;
+        if (s & 1) {
+            vTaskDelay(1);
             continue;
+        }
+        memcpy(dst, src, len);
+        if (!seq_read_retry(seq, s))
+            return ESP_OK;
+    }
+    return ESP_ERR_TIMEOUT;
+}
 
-        // Check if we received a valid handle or stop signal
-        if (wavh == NULL)
-            break;
+static void clock_publish(struct esp_wav_player *player, int64_t frames, uint32_t rate)
+{
+    uint32_t seq = seq_write_begin(&player->clock_seq);
+
+    player->clock.frames = frames;
+    player->clock.drain_at = player->drain_at;
+    player->clock.rate = rate;
+    seq_write_end(&player->clock_seq, seq);
+}
+
+esp_err_t esp_wav_player_get_position(esp_wav_player_t hdl, esp_wav_player_position_t *pos)
+{
+    if (!hdl || !pos)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    wav_clock_t            clk;
+
+    if (seq_read(&player->clock_seq, &clk, &player->clock, sizeof(clk)) != ESP_OK)
+        return ESP_ERR_TIMEOUT;
+    if (!clk.rate)
+        return ESP_ERR_INVALID_STATE;
+
+    // frames still queued in the DMA have not been output yet
+    pos->time_us = esp_timer_get_time();
+    pos->sample_rate = clk.rate;
+    pos->frame = clk.frames;
+    if (clk.drain_at > pos->time_us)
+        pos->frame -= (clk.drain_at - pos->time_us) * clk.rate / 1000000;
+    return ESP_OK;
+}
+
+/*
+ * Underrun detection: drain_at is when the audio queued so far runs out.
+ * Writing after that moment means the DMA played silence in between.
+ * A write that blocked returns with the DMA full, which caps drain_at and
+ * keeps the estimate from drifting against the I2S clock.
+ */
+static bool output_track(struct esp_wav_player *player, const wav_handle_t *wavh, int64_t t_before, size_t written)
+{
+    int64_t t_after = esp_timer_get_time();
+    int64_t dur_us = (int64_t)(written / player->out_align) * 1000000 / wavh->sample_rate;
+    bool    underrun = player->drain_at && t_before > player->drain_at;
+
+    if (player->drain_at < t_before)
+        player->drain_at = t_before;
+    player->drain_at += dur_us;
+    if (player->drain_at > t_after + player->dma_depth_us)
+        player->drain_at = t_after + player->dma_depth_us;
+
+    if (underrun) {
+        player->underruns++;
+        player->track_underruns++;
+    }
+    clock_publish(player, player->clock.frames + written / player->out_align, wavh->sample_rate);
+    return underrun;
+}
+
+esp_err_t esp_wav_player_get_buffering(esp_wav_player_t hdl, esp_wav_player_buffering_t *info)
+{
+    if (!hdl || !info)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    wav_source_type_t      type = player->track_type;
+
+    memset(info, 0, sizeof(*info));
+    info->chunk_size = player->chunk_size;
+    info->dma_buf_count = player->base_cfg.dma_buf_count;
+    info->dma_buf_len = player->base_cfg.dma_buf_len;
+    info->underruns = player->underruns;
+    if (type < WAV_SRC_MAX) {
+        info->read_avg_us = player->latency[type].avg_us;
+        info->read_peak_us = player->latency[type].peak_us;
+    }
+    return ESP_OK;
+}
+
+static void latency_update(struct esp_wav_player *player, const wav_handle_t *h, uint32_t dt_us, size_t n)
+{
+    wav_latency_t *lat = &player->latency[h->type];
+    uint32_t       load = (uint64_t)dt_us * h->byte_rate * 256 / ((uint64_t)n * 1000000);
+
+    if (!lat->avg_us) {
+        lat->avg_us = dt_us;
+        lat->load_q8 = load;
+    }
+    lat->avg_us += ((int32_t)dt_us - (int32_t)lat->avg_us) / 8;
+    lat->load_q8 += ((int32_t)load - (int32_t)lat->load_q8) / 8;
+    if (dt_us > lat->peak_us)
+        lat->peak_us = dt_us;
+}
+
+/*
+ * Pick buffering for the next track from what was measured on its source type:
+ * - chunk size doubles while reads take over 1/4 of the audio time they
+ *   deliver (per-call overhead dominates) and halves below 1/16
+ * - DMA depth must hold 1.5x the worst read plus one DMA buffer, and one
+ *   more buffer whenever the last track on this source underran
+ * Changing the DMA depth reinstalls the I2S driver, so it only happens
+ * between tracks and only when the count changes.
+ */
+static void buffering_adapt(struct esp_wav_player *player, const wav_handle_t *h, bool underran)
+{
+    wav_latency_t *lat = &player->latency[h->type];
+    i2s_config_t  *cfg = &player->base_cfg;
+    size_t         chunk = player->chunk_size;
+    int            count;
+
+    if (!lat->avg_us)
+        return; // nothing measured yet for this source type
+
+    if (lat->load_q8 > 256 / 4 && chunk * 2 <= player->buf_size)
+        chunk *= 2;
+    else if (lat->load_q8 < 256 / 16 && chunk / 2 >= WAV_CHUNK_MIN)
+        chunk /= 2;
+    player->chunk_size = chunk;
+
+    uint64_t frames = (uint64_t)lat->peak_us * 3 / 2 * h->sample_rate / 1000000;
+    count = (frames + cfg->dma_buf_len - 1) / cfg->dma_buf_len + 1 + (underran ? 1 : 0);
+    if (count < 2)
+        count = 2;
+    if (count > player->dma_buf_count_max)
+        count = player->dma_buf_count_max;
+
+    if (count != cfg->dma_buf_count) {
+        ESP_LOGI(TAG, "dma_buf_count %d -> %d (read peak %" PRIu32 " us)", cfg->dma_buf_count, count, lat->peak_us);
+        cfg->dma_buf_count = count;
+        zones_uninstall(player);
+        zones_install(player);
+    }
+}
+
+esp_err_t esp_wav_player_add_stage(esp_wav_player_t hdl, const wav_dsp_stage_t *stage, void *ctx)
+{
+    if (!hdl || !stage || !stage->process)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    if (player->state != ESP_WAV_PLAYER_STOPPED)
+        return ESP_ERR_INVALID_STATE;
+
+    if (player->num_stages >= ESP_WAV_PLAYER_MAX_STAGES)
+        return ESP_ERR_NO_MEM;
+
+    player->stages[player->num_stages].stage = stage;
+    player->stages[player->num_stages].ctx = ctx;
+    player->num_stages++;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_player_clear_stages(esp_wav_player_t hdl)
+{
+    if (!hdl)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    if (player->state != ESP_WAV_PLAYER_STOPPED)
+        return ESP_ERR_INVALID_STATE;
+
+    player->num_stages = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_player_set_metering(esp_wav_player_t hdl, bool enable)
+{
+    if (!hdl)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    player->metering = enable;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_player_get_meter(esp_wav_player_t hdl, esp_wav_player_meter_t *meter)
+{
+    if (!hdl || !meter)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+
+    if (seq_read(&player->meter_seq, meter, &player->meter, sizeof(*meter)) != ESP_OK)
+        return ESP_ERR_TIMEOUT;
+
+    meter->rms = meter->samples ? (uint16_t)sqrtf((float)meter->sum_sq / meter->samples) : 0;
+    return ESP_OK;
+}
+
+// single writer (player task), readers never block it
+static void meter_publish(struct esp_wav_player *player, const wav_meter_acc_t *acc, size_t samples)
+{
+    uint32_t seq = seq_write_begin(&player->meter_seq);
+
+    player->meter.peak = acc->peak;
+    player->meter.clipped = acc->clipped;
+    player->meter.sum_sq = acc->sum_sq;
+    player->meter.samples = samples;
+    player->meter.seq = seq / 2 + 1;
+    seq_write_end(&player->meter_seq, seq);
+}
+
+/*
+ * Crossfade kernels: `a` (ending track) is overwritten with the mix of `a`
+ * and `b` (next track) under a linear ramp, in the track format. `ramp` is
+ * the position in the overlap as a Q32 fraction, advanced by `step` per
+ * frame. The volume gains are folded into per-frame Q12 weights, which keeps
+ * the sum within 32 bits.
+ */
+static inline __attribute__((always_inline)) void mix_u8(uint8_t *a, const uint8_t *b, size_t frames, int ch,
+                                                         uint32_t ramp, uint32_t step, int32_t ga, int32_t gb)
+{
+    for (size_t f = 0; f < frames; f++, ramp += step) {
+        int32_t r = ramp >> 16;
+        int32_t wa = (ga * (65536 - r)) >> (16 + GAIN_SHIFT - XFADE_SHIFT);
+        int32_t wb = (gb * r) >> (16 + GAIN_SHIFT - XFADE_SHIFT);
+
+        for (int c = 0; c < ch; c++, a++, b++) {
+            int32_t v = (((int32_t)*a - 128) * wa + ((int32_t)*b - 128) * wb) >> XFADE_SHIFT;
+            if (v > 127)
+                v = 127;
+            else if (v < -128)
+                v = -128;
+            *a = (uint8_t)(v + 128);
+        }
+    }
+}
+
+static inline __attribute__((always_inline)) void mix_s16(int16_t *a, const int16_t *b, size_t frames, int ch,
+                                                          uint32_t ramp, uint32_t step, int32_t ga, int32_t gb)
+{
+    for (size_t f = 0; f < frames; f++, ramp += step) {
+        int32_t r = ramp >> 16;
+        int32_t wa = (ga * (65536 - r)) >> (16 + GAIN_SHIFT - XFADE_SHIFT);
+        int32_t wb = (gb * r) >> (16 + GAIN_SHIFT - XFADE_SHIFT);
+
+        for (int c = 0; c < ch; c++, a++, b++) {
+            int32_t v = (*a * wa + *b * wb) >> XFADE_SHIFT;
+            if (v > INT16_MAX)
+                v = INT16_MAX;
+            else if (v < INT16_MIN)
+                v = INT16_MIN;
+            *a = (int16_t)v;
+        }
+    }
+}
+
+// validate the chain once per track, so process() never checks formats
+static void dsp_chain_prepare(struct esp_wav_player *player, const wav_handle_t *wavh)
+{
+    wav_dsp_format_t fmt = {
+        .sample_rate = wavh->sample_rate,
+        .bit_depth = 16,
+        .num_channels = player->out_ch,
+    };
+    uint32_t flags = fmt.num_channels == 1 ? WAV_DSP_FMT_MONO : WAV_DSP_FMT_STEREO;
+
+    player->num_active = 0;
+    for (size_t i = 0; i < player->num_stages; i++) {
+        const wav_dsp_slot_t *slot = &player->stages[i];
 
-        if (wavh->open(wavh) != 0) {
-            wavh->close(wavh);
-            player->state = ESP_WAV_PLAYER_STOPPED;
-            ESP_LOGE(TAG, "wav open failed");
+        if (!(slot->stage->formats & flags)) {
+            ESP_LOGW(TAG, "stage %s skipped: format not supported", slot->stage->name);
             continue;
         }
-        if (wav_parse_header(wavh) != 0) {
-            wavh->close(wavh);
-            player->state = ESP_WAV_PLAYER_STOPPED;
+        if (slot->stage->prepare && slot->stage->prepare(slot->ctx, &fmt) != ESP_OK) {
+            ESP_LOGW(TAG, "stage %s skipped: prepare failed", slot->stage->name);
             continue;
         }
+        player->active[player->num_active++] = *slot;
+    }
+}
+
+static void dsp_chain_run(struct esp_wav_player *player, void *buf, size_t samples)
+{
+    for (size_t i = 0; i < player->num_active; i++)
+        player->active[i].stage->process(player->active[i].ctx, buf, samples);
+}
+
+// blocking write of silence, keeps drain_at up to date
+static void output_silence(struct esp_wav_player *player, size_t bytes)
+{
+    const wav_handle_t *h = player->track.h;
+    size_t              done[ESP_WAV_PLAYER_MAX_ZONES] = { 0 };
+
+    memset(player->buf, 0, player->buf_size);
+    while (bytes && !player->stop_request) {
+        size_t  n = bytes < player->buf_size ? bytes : player->buf_size;
+        size_t  i2s_wr = n;
+        int64_t t_before = esp_timer_get_time();
+
+        // as in output_write(), every zone tops up to `n` and the clock follows the slowest
+        for (size_t i = 0; i < player->num_zones; i++) {
+            size_t wr = 0;
+
+            if (done[i] < n)
+                i2s_write(player->zones[i].i2s_num, player->buf, n - done[i], &wr, portMAX_DELAY);
+            done[i] += wr;
+            if (done[i] < i2s_wr)
+                i2s_wr = done[i];
+        }
+        if (!i2s_wr)
+            break;
+        for (size_t i = 0; i < player->num_zones; i++)
+            done[i] -= i2s_wr;
+        output_track(player, h, t_before, i2s_wr);
+        bytes -= i2s_wr;
+    }
+}
+
+/*
+ * Zone delays are leading silence. Written while the zones are in step, the
+ * offset holds for the whole track because all zones run from the same clock
+ * and every write waits for the slowest one. A delay must fit the DMA next
+ * to the audio, or the zone would block the others while it drains.
+ */
+static void zones_align(struct esp_wav_player *player, uint32_t rate)
+{
+    static const uint8_t zeros[256];
+    size_t               max = (size_t)(player->base_cfg.dma_buf_count - 1) * player->base_cfg.dma_buf_len;
+
+    for (size_t i = 0; i < player->num_zones; i++) {
+        size_t frames = (uint64_t)player->zones[i].delay_us * rate / 1000000;
+        size_t bytes = (frames < max ? frames : max) * player->out_align;
+
+        while (bytes && !player->stop_request) {
+            size_t n = bytes < sizeof(zeros) ? bytes : sizeof(zeros);
+            size_t i2s_wr = 0;
+
+            i2s_write(player->zones[i].i2s_num, zeros, n, &i2s_wr, portMAX_DELAY);
+            bytes -= i2s_wr;
+        }
+    }
+}
+
+// after a pause the zones drained at different times: restart them in step
+static void zones_resume(struct esp_wav_player *player)
+{
+    if (!player->zone_delays || !player->track.h)
+        return;
+
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_zero_dma_buffer(player->zones[i].i2s_num);
+    zones_align(player, player->track.h->sample_rate);
+}
+
+// stop the I2S clocks and allow light sleep until the next track
+static void output_idle(struct esp_wav_player *player)
+{
+    if (player->idle)
+        return;
+
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_stop(player->zones[i].i2s_num);
+#if CONFIG_PM_ENABLE
+    if (player->pm_lock)
+        esp_pm_lock_release(player->pm_lock);
+#endif
+    player->idle = true;
+    player->idle_stops++;
+}
+
+static void output_wake(struct esp_wav_player *player)
+{
+    if (!player->idle)
+        return;
+
+#if CONFIG_PM_ENABLE
+    if (player->pm_lock)
+        esp_pm_lock_acquire(player->pm_lock);
+#endif
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_start(player->zones[i].i2s_num);
+    player->idle = false;
+    player->wake_at = esp_timer_get_time();
+}
+
+// how long the task may wait for a track before the output goes idle
+static TickType_t idle_ticks(const struct esp_wav_player *player)
+{
+    TickType_t ticks = pdMS_TO_TICKS(player->idle_stop_ms);
+
+    if (player->idle || !player->idle_stop_ms)
+        return portMAX_DELAY;
+    return ticks ? ticks : 1;
+}
+
+// drop pending audio, e.g. at a track boundary
+static void output_reset(struct esp_wav_player *player)
+{
+    player->pend = player->buf;
+    player->pend_len = 0;
+    for (size_t i = 0; i < player->num_zones; i++)
+        player->zones[i].done = 0;
+}
+
+/*
+ * Scheduled start: sleep until shortly before `at`, then fill the DMA with
+ * silence. Once the DMA is full every blocking write returns right after a
+ * DMA buffer completed, so drain_at is exact to within the task wake-up
+ * latency. A final silence pad of (at - drain_at) then puts the first sample
+ * of the track on the wire at `at`.
+ */
+static void track_schedule(struct esp_wav_player *player, int64_t at)
+{
+    const wav_handle_t *h = player->track.h;
+    size_t              dma_bytes = player->base_cfg.dma_buf_len * player->out_align;
+    int64_t             lead = 2 * player->dma_depth_us + WAV_SCHED_MARGIN_US;
+    int64_t             wait_us;
+
+    while (!player->stop_request && (wait_us = at - lead - esp_timer_get_time()) > 0) {
+        TickType_t ticks = pdMS_TO_TICKS(wait_us / 1000);
+        vTaskDelay(ticks > 10 ? 10 : ticks ? ticks : 1);
+    }
+
+    output_silence(player, dma_bytes * (player->base_cfg.dma_buf_count + 1));
+
+    int64_t pad_us = at - player->drain_at;
+    if (pad_us < 0)
+        ESP_LOGW(TAG, "scheduled start late by %" PRId64 " us", -pad_us);
+    else
+        output_silence(player, pad_us * h->sample_rate / 1000000 * player->out_align);
+
+    player->start_us = player->drain_at;
+}
+
+// open the track and parse its header, frees the handle on failure
+static bool track_open(struct esp_wav_player *player, wav_handle_t *wavh)
+{
+    if (wavh->open(wavh) != 0) {
+        wavh->close(wavh);
+        wav_handle_free(wavh);
+        ESP_LOGE(TAG, "wav open failed");
+        player_post(player, ESP_WAV_PLAYER_EVENT_ERROR, NULL, 0, ESP_ERR_NOT_FOUND);
+        return false;
+    }
+    if (wav_parse_header(wavh) != 0) {
+        wavh->close(wavh);
+        wav_handle_free(wavh);
+        player_post(player, ESP_WAV_PLAYER_EVENT_ERROR, NULL, 0, ESP_ERR_NOT_SUPPORTED);
+        return false;
+    }
+    return true;
+}
+
+// user volume and clip gain folded into the one multiplier the conversion applies anyway
+static int32_t track_gain(uint8_t volume, float gain_db)
+{
+    int32_t gain = (volume * GAIN_UNITY) / 100;
+
+    if (gain_db > CLIP_GAIN_MAX_DB)
+        gain_db = CLIP_GAIN_MAX_DB;
+    if (gain_db != 0.0f)
+        gain = (int32_t)lrintf(gain * powf(10.0f, gain_db / 20.0f));
+    return gain;
+}
+
+static void track_init(struct esp_wav_player *player, wav_track_t *t, wav_handle_t *wavh)
+{
+    size_t frame = wavh->sample_alignment > player->out_align ? wavh->sample_alignment : player->out_align;
+
+    t->h = wavh;
+    t->gain = track_gain(player->volume, wavh->gain_db);
+    t->metering = player->metering;
+    t->conv = wav_conv_select(wavh, player->out_ch, t->metering);
+    wav_conv_gains(wavh, player->out_ch, t->gain << (CONV_SHIFT - GAIN_SHIFT), t->conv_gain);
+    // nothing to do per sample: skip the copy too when the source can map its data
+    t->direct = wavh->map && !t->metering && !player->num_active && t->conv_gain[0] == CONV_UNITY &&
+                t->conv_gain[1] == CONV_UNITY && wavh->bit_depth == 16 && wavh->num_channels == player->out_ch;
+    t->read_max = player->buf_size / frame * wavh->sample_alignment;
+    t->bytes_left = wavh->data_bytes;
+    t->bytes_done = 0;
+    t->progress_step = (uint64_t)wavh->sample_rate * player->out_align * player->progress_interval_ms / 1000;
+    t->progress_at = t->progress_step;
+}
+
+// prepare the output for an opened track
+static void track_start(struct esp_wav_player *player, wav_handle_t *wavh)
+{
+    player->state = ESP_WAV_PLAYER_PLAYING;
+    player->stop_request = false;
+    player->pause_request = false;
+
+    output_wake(player);
+    dsp_chain_prepare(player, wavh);
+    track_init(player, &player->track, wavh);
+    player->track_type = wavh->type;
+    output_reset(player);
+
+    if (player->adaptive)
+        buffering_adapt(player, wavh, player->track_underruns);
+    player->track_underruns = 0;
+
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_set_sample_rates(player->zones[i].i2s_num, wavh->sample_rate);
+    player->drain_at = 0;
+    player->dma_depth_us =
+        (int64_t)player->base_cfg.dma_buf_count * player->base_cfg.dma_buf_len * 1000000 / wavh->sample_rate;
+
+    player->start_us = 0;
+    clock_publish(player, 0, wavh->sample_rate);
+    if (wavh->start_at) {
+        player->wake_at = 0; // the wait for the start time is not wake-up latency
+        track_schedule(player, wavh->start_at);
+        // silence still queued now reads as negative frame indexes
+        clock_publish(player, 0, wavh->sample_rate);
+    }
+    if (player->zone_delays)
+        zones_align(player, wavh->sample_rate);
+    player_post(player, ESP_WAV_PLAYER_EVENT_START, wavh, 0, ESP_OK);
+}
+
+static bool track_begin(struct esp_wav_player *player, wav_handle_t *wavh)
+{
+    // the clocks restart while the file opens
+    output_wake(player);
+    if (!track_open(player, wavh)) {
+        player->state = ESP_WAV_PLAYER_STOPPED;
+        return false;
+    }
+    track_start(player, wavh);
+    return true;
+}
+
+// start the track opened ahead for a crossfade that did not happen
+static bool track_begin_next(struct esp_wav_player *player)
+{
+    wav_handle_t *wavh = player->next.h;
+
+    if (!wavh)
+        return false;
+
+    memset(&player->next, 0, sizeof(player->next));
+    track_start(player, wavh);
+    return true;
+}
+
+// drop audio read ahead from the next track so it can start from the beginning
+static void xfade_rewind(struct esp_wav_player *player)
+{
+    wav_track_t *nx = &player->next;
+
+    player->xlen = 0;
+    if (!nx->h || !player->next_mix)
+        return;
+
+    player->next_mix = false;
+    if (nx->h->seek(nx->h, nx->h->data_start) != 0) {
+        player_post(player, ESP_WAV_PLAYER_EVENT_ERROR, nx->h, 0, ESP_FAIL);
+        nx->h->close(nx->h);
+        wav_handle_free(nx->h);
+        nx->h = NULL;
+        return;
+    }
+    nx->bytes_left = nx->h->data_bytes;
+}
+
+static void track_end(struct esp_wav_player *player)
+{
+    wav_track_t *t = &player->track;
+
+    for (size_t i = 0; i < player->num_zones; i++)
+        i2s_zero_dma_buffer(player->zones[i].i2s_num);
+    player->drain_at = 0;
+    clock_publish(player, 0, 0);
+    player_post(player, ESP_WAV_PLAYER_EVENT_END, t->h, t->bytes_done, ESP_OK);
+    // let the peak recover from one-off stalls
+    player->latency[t->h->type].peak_us -= player->latency[t->h->type].peak_us / 8;
+
+    player->track_type = WAV_SRC_MAX;
+    t->h->close(t->h);
+    wav_handle_free(t->h);
+    t->h = NULL;
+    output_reset(player);
+    player->idle_since = esp_timer_get_time();
+    player->state = ESP_WAV_PLAYER_STOPPED;
+    // stopped before or during a crossfade: the next track plays in full
+    xfade_rewind(player);
+}
+
+// convert `n` source bytes in buf to the sink layout and run the stages, returns the output size
+static size_t track_process(struct esp_wav_player *player, uint8_t *buf, size_t n, const int32_t *g)
+{
+    wav_track_t    *t = &player->track;
+    size_t          frames = n / t->h->sample_alignment;
+    size_t          samples = frames * player->out_ch;
+    wav_meter_acc_t acc;
+
+    // skipped only when the track is already in the sink layout at unity gain
+    if (t->metering || g[0] != CONV_UNITY || g[1] != CONV_UNITY || t->h->bit_depth != 16 ||
+        t->h->num_channels != player->out_ch)
+        t->conv(buf, frames, g, &acc);
+
+    if (t->metering)
+        meter_publish(player, &acc, samples);
+
+    if (player->num_active)
+        dsp_chain_run(player, buf, samples);
+    return frames * player->out_align;
+}
+
+/*
+ * Write to one zone. A zone at unity gain takes the shared buffer directly;
+ * otherwise the gain is applied on the way in small pieces, so no zone needs
+ * its own copy of the audio.
+ */
+static size_t zone_write(const wav_zone_t *z, const uint8_t *src, size_t len, TickType_t wait)
+{
+    int16_t scratch[128];
+    int32_t g = z->gain;
+    size_t  done = 0;
+    size_t  i2s_wr = 0;
+
+    if (g == GAIN_UNITY) {
+        i2s_write(z->i2s_num, src, len, &i2s_wr, wait);
+        return i2s_wr;
+    }
+
+    while (done < len) {
+        size_t n = len - done < sizeof(scratch) ? len - done : sizeof(scratch);
+
+        memcpy(scratch, src + done, n);
+        for (size_t i = 0; i < n / sizeof(int16_t); i++)
+            scratch[i] = (int16_t)((scratch[i] * g) >> GAIN_SHIFT);
+
+        i2s_wr = 0;
+        i2s_write(z->i2s_num, scratch, n, &i2s_wr, wait);
+        done += i2s_wr;
+        if (i2s_wr < n)
+            break;
+    }
+    return done;
+}
+
+// hand pending audio to every zone, returns true when all of them accepted all of it
+static bool output_write(struct esp_wav_player *player, TickType_t wait)
+{
+    wav_track_t *t = &player->track;
+    size_t       i2s_wr = player->pend_len;
+    int64_t      t_before = esp_timer_get_time();
+
+    // the output advances at the pace of the slowest zone
+    for (size_t i = 0; i < player->num_zones; i++) {
+        wav_zone_t *z = &player->zones[i];
+
+        z->done += zone_write(z, player->pend + z->done, player->pend_len - z->done, wait);
+        if (z->done < i2s_wr)
+            i2s_wr = z->done;
+    }
+    if (!i2s_wr)
+        return false;
+
+    if (player->wake_at) {
+        player->wake_us = t_before - player->wake_at;
+        if (player->wake_us > player->wake_max_us)
+            player->wake_max_us = player->wake_us;
+        player->wake_at = 0;
+        ESP_LOGD(TAG, "first sample %" PRIu32 " us after wake-up", player->wake_us);
+    }
+    for (size_t i = 0; i < player->num_zones; i++)
+        player->zones[i].done -= i2s_wr;
+    player->pend += i2s_wr;
+    player->pend_len -= i2s_wr;
+    t->bytes_done += i2s_wr;
+
+    if (output_track(player, t->h, t_before, i2s_wr))
+        player_post(player, ESP_WAV_PLAYER_EVENT_UNDERRUN, t->h, t->bytes_done, ESP_OK);
+
+    if (t->progress_step && t->bytes_done >= t->progress_at) {
+        t->progress_at += t->progress_step;
+        player_post(player, ESP_WAV_PLAYER_EVENT_PROGRESS, t->h, t->bytes_done, ESP_OK);
+    }
+    return player->pend_len == 0;
+}
+
+// top up the read-ahead of the next track to `need` bytes
+static bool xfade_fill(struct esp_wav_player *player, size_t need)
+{
+    wav_track_t *nx = &player->next;
+    size_t       n;
+
+    if (player->xlen >= need)
+        return true;
+
+    memmove(player->xbuf, player->xbuf + player->xoff, player->xlen);
+    player->xoff = 0;
+
+    n = need - player->xlen;
+    if (n > nx->bytes_left)
+        n = nx->bytes_left;
+
+    int64_t t_read = esp_timer_get_time();
+    n = nx->h->read(nx->h, player->xbuf + player->xlen, n);
+    if (n && player->adaptive)
+        latency_update(player, nx->h, esp_timer_get_time() - t_read, n);
+
+    nx->bytes_left -= n;
+    player->xlen += n;
+    return player->xlen >= need;
+}
+
+/*
+ * Open the next queued track ahead of the transition and read its first
+ * chunk. This runs right after a write returned, with the DMA full, so the
+ * queued audio absorbs a slow open. Starting one DMA depth plus one chunk
+ * before the overlap lets the DMA refill before every buffer needs two reads.
+ */
+static void xfade_preroll(struct esp_wav_player *player)
+{
+    wav_track_t  *t = &player->track;
+    wav_track_t  *nx = &player->next;
+    size_t        align = t->h->sample_alignment;
+    size_t        len = (uint64_t)t->h->byte_rate * player->crossfade_ms / 1000;
+    size_t        lead = player->dma_depth_us * t->h->byte_rate / 1000000 + player->chunk_size;
+    wav_handle_t *wavh;
+
+    if (nx->h || t->bytes_left > len + lead)
+        return;
+    if (xQueueReceive(player->queue, &wavh, 0) != pdTRUE || !wavh)
+        return;
+    if (!track_open(player, wavh))
+        return;
+
+    track_init(player, nx, wavh);
+    player->xoff = 0;
+    player->xlen = 0;
+
+    // a format change needs the I2S reconfigured, the track then starts after this one
+    if (wavh->start_at || wavh->sample_rate != t->h->sample_rate || wavh->bit_depth != t->h->bit_depth ||
+        wavh->num_channels != t->h->num_channels)
+        return;
+
+    if (len > t->bytes_left)
+        len = t->bytes_left;
+    if (len > wavh->data_bytes)
+        len = wavh->data_bytes;
+    len -= len % align;
+    if (len < 2 * align)
+        return;
+
+    player->next_mix = true;
+    player->xfade_len = len;
+    player->xfade_step = (uint32_t)((1ULL << 32) / (len / align));
+    if (len > player->chunk_size)
+        len = player->chunk_size;
+    if (len > nx->read_max)
+        len = nx->read_max;
+    xfade_fill(player, len);
+}
+
+/*
+ * Replace `n` bytes of the ending track in buf with the crossfade mix. Both
+ * tracks have the same format, so they are mixed as read and the result is
+ * converted to the sink layout like a single track at unity volume.
+ */
+static size_t xfade_mix(struct esp_wav_player *player, size_t n)
+{
+    wav_track_t *t = &player->track;
+    wav_track_t *nx = &player->next;
+    size_t       align = t->h->sample_alignment;
+    size_t       frames = n / align;
+    uint32_t     ramp = (uint64_t)(player->xfade_len - t->bytes_left - n) / align * player->xfade_step;
+    uint32_t     step = player->xfade_step;
+    int          ch = t->h->num_channels;
+    int32_t      g[2];
+
+    if (!xfade_fill(player, n)) {
+        player_post(player, ESP_WAV_PLAYER_EVENT_ERROR, nx->h, 0, ESP_ERR_INVALID_SIZE);
+        nx->h->close(nx->h);
+        wav_handle_free(nx->h);
+        memset(nx, 0, sizeof(*nx));
+        player->next_mix = false;
+        player->xlen = 0;
+        return track_process(player, player->buf, n, t->conv_gain);
+    }
+
+    uint8_t *b = player->xbuf + player->xoff;
+    if (t->h->bit_depth == 8)
+        mix_u8(player->buf, b, frames, ch, ramp, step, t->gain, nx->gain);
+    else
+        mix_s16((int16_t *)player->buf, (int16_t *)b, frames, ch, ramp, step, t->gain, nx->gain);
+    player->xoff += n;
+    player->xlen -= n;
+
+    wav_conv_gains(t->h, player->out_ch, CONV_UNITY, g);
+    return track_process(player, player->buf, n, g);
+}
+
+// the ending track ran out mid-crossfade: the next one takes over without touching the output
+static void xfade_handover(struct esp_wav_player *player)
+{
+    wav_track_t *t = &player->track;
+    wav_track_t *nx = &player->next;
+
+    player_post(player, ESP_WAV_PLAYER_EVENT_END, t->h, t->bytes_done, ESP_OK);
+    player->latency[t->h->type].peak_us -= player->latency[t->h->type].peak_us / 8;
+    t->h->close(t->h);
+    wav_handle_free(t->h);
+
+    *t = *nx;
+    memset(nx, 0, sizeof(*nx));
+    player->next_mix = false;
+    player->track_type = t->h->type;
+
+    size_t frames = (t->h->data_bytes - t->bytes_left - player->xlen) / t->h->sample_alignment;
+    t->bytes_done = frames * player->out_align;
+    if (t->progress_step)
+        t->progress_at = (t->bytes_done / t->progress_step + 1) * t->progress_step;
+
+    player->start_us = 0;
+    clock_publish(player, frames, t->h->sample_rate);
+    player_post(player, ESP_WAV_PLAYER_EVENT_START, t->h, t->bytes_done, ESP_OK);
+
+    // read-ahead past the overlap is plain audio of the new track
+    if (player->xlen) {
+        memcpy(player->buf, player->xbuf + player->xoff, player->xlen);
+        player->pend = player->buf;
+        player->pend_len = track_process(player, player->buf, player->xlen, t->conv_gain);
+        player->xlen = 0;
+    }
+}
+
+/*
+ * Move up to `max_bytes` of the current track from the source to I2S.
+ * Returns the number of source bytes consumed; 0 with nothing pending means
+ * the track is finished, 0 with pending data means I2S is full.
+ */
+static size_t track_pump(struct esp_wav_player *player, size_t max_bytes, TickType_t wait)
+{
+    wav_track_t *t = &player->track;
+    size_t       align = t->h->sample_alignment ? t->h->sample_alignment : 1;
+    bool         mix;
+    size_t       n;
+
+    if (player->pend_len && !output_write(player, wait))
+        return 0;
+
+    if (player->crossfade_ms) {
+        xfade_preroll(player);
+        if (!t->bytes_left && player->next_mix) {
+            xfade_handover(player);
+            if (player->pend_len && !output_write(player, wait))
+                return 0;
+        }
+    }
+
+    // with a crossfade ahead, stop exactly where the overlap begins
+    mix = player->next_mix && t->bytes_left <= player->xfade_len;
+    n = t->bytes_left;
+    if (player->next_mix && !mix)
+        n -= player->xfade_len;
+    if (n > player->chunk_size)
+        n = player->chunk_size;
+    if (n > t->read_max)
+        n = t->read_max;
+    if (n > max_bytes)
+        n = max_bytes;
+    if (n > align)
+        n -= n % align;
+    if (n == 0)
+        return 0;
+
+    if (t->direct && !mix) {
+        player->pend = t->h->map(t->h, &n);
+        player->pend_len = n;
+    } else {
+        int64_t t_read = esp_timer_get_time();
+        n = t->h->read(t->h, player->buf, n);
+        if (n && player->adaptive)
+            latency_update(player, t->h, esp_timer_get_time() - t_read, n);
+    }
+    if (n == 0) {
+        player_post(player, ESP_WAV_PLAYER_EVENT_ERROR, t->h, t->bytes_done, ESP_ERR_INVALID_SIZE);
+        t->bytes_left = 0;
+        return 0;
+    }
+    t->bytes_left -= n;
+
+    if (!t->direct || mix) {
+        player->pend = player->buf;
+        player->pend_len = mix ? xfade_mix(player, n) : track_process(player, player->buf, n, t->conv_gain);
+    }
+    output_write(player, wait);
+    return n;
+}
+
+esp_err_t esp_wav_player_process(esp_wav_player_t hdl, size_t budget)
+{
+    if (!hdl)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_player *player = (struct esp_wav_player *)hdl;
+    wav_track_t           *t = &player->track;
 
-        player->state = ESP_WAV_PLAYER_PLAYING;
-        player->stop_request = false;
-        player->pause_request = false;
+    if (player->mode != ESP_WAV_PLAYER_MODE_COOPERATIVE)
+        return ESP_ERR_INVALID_STATE;
 
-        if (player->on_start)
-            player->on_start(player, player->on_start_arg);
+    while (!t->h) {
+        wav_handle_t *wavh;
+        if (track_begin_next(player))
+            break;
+        if (xQueueReceive(player->queue, &wavh, 0) != pdTRUE) {
+            if (player->idle_stop_ms &&
+                esp_timer_get_time() - player->idle_since >= (int64_t)player->idle_stop_ms * 1000)
+                output_idle(player);
+            return ESP_OK;
+        }
+        if (wavh)
+            track_begin(player, wavh);
+    }
 
-        float vol = player->volume / 100.0f;
-        int   bytes_left = wavh->data_bytes;
+    if (player->stop_request) {
+        track_end(player);
+        return ESP_OK;
+    }
+    if (player->pause_request) {
+        player->state = ESP_WAV_PLAYER_PAUSED;
+        player->drain_at = 0;
+        return ESP_OK;
+    }
+    if (player->state == ESP_WAV_PLAYER_PAUSED)
+        zones_resume(player);
+    player->state = ESP_WAV_PLAYER_PLAYING;
+
+    for (size_t left = budget * t->h->sample_alignment; left;) {
+        size_t n = track_pump(player, left, 0);
+        if (n == 0) {
+            if (!player->pend_len)
+                track_end(player);
+            break;
+        }
+        left = n < left ? left - n : 0;
+    }
+    return ESP_OK;
+}
+
+static void wav_player_task(void *arg)
+{
+    struct esp_wav_player *player = arg;
+    wav_handle_t          *wavh = NULL;
+
+    while (1) {
+        if (!track_begin_next(player)) {
+            if (!xQueueReceive(player->queue, &wavh, idle_ticks(player))) {
+                output_idle(player);
+                continue;
+            }
+
+            // Check if we received a valid handle or stop signal
+            if (wavh == NULL)
+                break;
+
+            if (!track_begin(player, wavh))
+                continue;
+        }
 
-        i2s_set_clk(player->i2s_num, wavh->sample_rate, wavh->bit_depth, wavh->num_channels);
         while (!player->stop_request) {
             if (player->pause_request) {
                 player->state = ESP_WAV_PLAYER_PAUSED;
+                player->drain_at = 0;
                 vTaskDelay(10);
                 continue;
             }
-            if (bytes_left <= 0)
+            if (player->state == ESP_WAV_PLAYER_PAUSED)
+                zones_resume(player);
+            player->state = ESP_WAV_PLAYER_PLAYING;
+            if (track_pump(player, player->buf_size, portMAX_DELAY) == 0 && !player->pend_len)
                 break;
-
-            size_t n = wavh->read(wavh, buf, WAV_BUF_SIZE);
-            if (n == 0)
-                break;
-
-            switch (wavh->bit_depth) {
-            case 8: {
-                uint8_t *sample = buf;
-                for (size_t i = 0; i < n; i++) {
-                    int16_t v = ((int16_t)sample[i] - 128);
-                    v = v * vol;
-                    v += 128;
-                    if (v < 0)
-                        v = 0;
-                    if (v > 255)
-                        v = 255;
-                    sample[i] = (uint8_t)v;
-                }
-            } break;
-            case 16: {
-                int16_t *sample = (int16_t *)buf;
-                size_t   count = n / 2;
-                for (size_t i = 0; i < count; i++)
-                    sample[i] = (int16_t)(sample[i] * vol);
-            } break;
-            default:
-                break;
-            }
-            i2s_write(player->i2s_num, buf, n, &i2s_wr, portMAX_DELAY);
-            bytes_left -= i2s_wr;
         }
-        i2s_zero_dma_buffer(player->i2s_num);
-        wavh->close(wavh);
-        wav_handle_free(wavh);
-        if (player->on_end)
-            player->on_end(player, player->on_end_arg);
-
-        player->state = ESP_WAV_PLAYER_STOPPED;
+        track_end(player);
     }
 }
@@ -0,0 +1,427 @@
+#include "include/esp_wav_recorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "wav_header.h"
+
+#define REC_BUF_SIZE  8192
+#define REC_SECTOR    512
+#define REC_QUEUE_LEN 6
+
+static const char *TAG = "WAVREC";
+
+/* data == NULL marks the end of a recording */
+typedef struct {
+    uint8_t *data;
+    size_t   len;
+    bool     release; /* transfer buffer, handed back to the capture task once written */
+} rec_item_t;
+
+struct esp_wav_recorder {
+    TaskHandle_t      capture_task;
+    TaskHandle_t      writer_task;
+    QueueHandle_t     full_q; /* rec_item_t, capture -> writer */
+    QueueHandle_t     free_q; /* uint8_t *, writer -> capture */
+    SemaphoreHandle_t flushed;
+    SemaphoreHandle_t done;
+
+    esp_wav_recorder_capture_t capture;
+    void                      *capture_arg;
+    int                        i2s_num;
+
+    uint32_t sample_rate;
+    uint16_t bit_depth;
+    uint16_t num_channels;
+    uint16_t align;
+    size_t   chunk; /* bytes per capture call, one DMA buffer */
+
+    uint8_t *bufs;
+    size_t   buf_size;
+
+    /* pre-trigger ring, only touched by the capture task while idle */
+    uint8_t *ring;
+    size_t   ring_size;
+    size_t   ring_pos;
+    bool     ring_full;
+
+    volatile bool start_request;
+    volatile bool stop_request;
+
+    /* owned by the writer task while recording */
+    FILE                    *f;
+    size_t                   file_pos;
+    esp_err_t                write_err;
+    esp_wav_recorder_stats_t stats;
+};
+
+static void rec_capture_task(void *arg);
+static void rec_writer_task(void *arg);
+
+static void rec_header(const struct esp_wav_recorder *rec, wav_header_t *hdr, uint32_t data_bytes)
+{
+    memcpy(hdr->riff_header, "RIFF", 4);
+    hdr->wav_size = data_bytes + (data_bytes & 1) + sizeof(*hdr) - 8;
+    memcpy(hdr->wave_header, "WAVE", 4);
+    memcpy(hdr->fmt_header, "fmt ", 4);
+    hdr->fmt_chunk_size = 16;
+    hdr->audio_format = 1; // PCM
+    hdr->num_channels = rec->num_channels;
+    hdr->sample_rate = rec->sample_rate;
+    hdr->byte_rate = rec->sample_rate * rec->align;
+    hdr->sample_alignment = rec->align;
+    hdr->bit_depth = rec->bit_depth;
+    memcpy(hdr->data_header, "data", 4);
+    hdr->data_bytes = data_bytes;
+}
+
+esp_err_t esp_wav_recorder_init(esp_wav_recorder_t *hdl, const esp_wav_recorder_config_t *cfg)
+{
+    if (!hdl || !cfg)
+        return ESP_ERR_INVALID_ARG;
+
+    // 8-bit WAV is unsigned while I2S delivers signed samples, 24-bit comes in 32-bit slots
+    if (cfg->base_cfg.bits_per_sample != 16 && cfg->base_cfg.bits_per_sample != 32)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    struct esp_wav_recorder *rec = calloc(1, sizeof(*rec));
+    if (!rec)
+        return ESP_ERR_NO_MEM;
+
+    rec->capture = cfg->capture;
+    rec->capture_arg = cfg->capture_arg;
+    rec->i2s_num = cfg->i2s_num;
+    rec->sample_rate = cfg->base_cfg.sample_rate;
+    rec->bit_depth = cfg->base_cfg.bits_per_sample;
+    rec->num_channels = (cfg->base_cfg.channel_format == I2S_CHANNEL_FMT_ONLY_LEFT ||
+                         cfg->base_cfg.channel_format == I2S_CHANNEL_FMT_ONLY_RIGHT)
+                            ? 1
+                            : 2;
+    rec->align = rec->num_channels * rec->bit_depth / 8;
+    rec->chunk = cfg->base_cfg.dma_buf_len * rec->align;
+
+    // whole sectors, so FATFS can write them straight from the buffer
+    rec->buf_size = cfg->buf_size ? cfg->buf_size : REC_BUF_SIZE;
+    rec->buf_size = (rec->buf_size + REC_SECTOR - 1) & ~(REC_SECTOR - 1);
+    if (rec->chunk > rec->buf_size)
+        rec->chunk = rec->buf_size;
+
+    rec->ring_size = (uint64_t)cfg->pretrigger_ms * rec->sample_rate / 1000 * rec->align;
+
+    rec->bufs = heap_caps_malloc(2 * rec->buf_size, MALLOC_CAP_DMA);
+    rec->ring = rec->ring_size ? malloc(rec->ring_size) : NULL;
+    rec->full_q = xQueueCreate(REC_QUEUE_LEN, sizeof(rec_item_t));
+    rec->free_q = xQueueCreate(2, sizeof(uint8_t *));
+    rec->flushed = xSemaphoreCreateBinary();
+    rec->done = xSemaphoreCreateBinary();
+    if (!rec->bufs || (rec->ring_size && !rec->ring) || !rec->full_q || !rec->free_q || !rec->flushed || !rec->done) {
+        esp_wav_recorder_deinit(rec);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        uint8_t *buf = rec->bufs + i * rec->buf_size;
+        xQueueSend(rec->free_q, &buf, 0);
+    }
+
+    if (!rec->capture) {
+        i2s_driver_install(rec->i2s_num, &cfg->base_cfg, 0, NULL);
+        i2s_set_pin(rec->i2s_num, &cfg->i2s_pin_config);
+    }
+
+    xTaskCreate(rec_writer_task, "wav_rec_writer", 4096, rec, 5, &rec->writer_task);
+    xTaskCreate(rec_capture_task, "wav_rec_capture", 3072, rec, 6, &rec->capture_task);
+
+    *hdl = rec;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_recorder_deinit(esp_wav_recorder_t hdl)
+{
+    if (!hdl)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_recorder *rec = (struct esp_wav_recorder *)hdl;
+
+    if (rec->f)
+        esp_wav_recorder_stop(rec);
+
+    if (rec->capture_task)
+        vTaskDelete(rec->capture_task);
+    if (rec->writer_task)
+        vTaskDelete(rec->writer_task);
+
+    if (!rec->capture && rec->capture_task)
+        i2s_driver_uninstall(rec->i2s_num);
+
+    if (rec->full_q)
+        vQueueDelete(rec->full_q);
+    if (rec->free_q)
+        vQueueDelete(rec->free_q);
+    if (rec->flushed)
+        vSemaphoreDelete(rec->flushed);
+    if (rec->done)
+        vSemaphoreDelete(rec->done);
+
+    heap_caps_free(rec->bufs);
+    free(rec->ring);
+    free(rec);
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_recorder_start(esp_wav_recorder_t hdl, const char *path)
+{
+    if (!hdl || !path)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_recorder *rec = (struct esp_wav_recorder *)hdl;
+    wav_header_t             hdr;
+
+    if (rec->f)
+        return ESP_ERR_INVALID_STATE;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "can't create %s", path);
+        return ESP_FAIL;
+    }
+    // writes are already large, stdio buffering would only add a copy
+    setvbuf(f, NULL, _IONBF, 0);
+
+    // sizes of a file that is never finalized read as unknown, like a stream
+    rec_header(rec, &hdr, UINT32_MAX);
+    hdr.wav_size = UINT32_MAX;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+        ESP_LOGE(TAG, "header write failed");
+        fclose(f);
+        return ESP_FAIL;
+    }
+
+    memset(&rec->stats, 0, sizeof(rec->stats));
+    rec->file_pos = sizeof(hdr);
+    rec->write_err = ESP_OK;
+    rec->f = f;
+    rec->start_request = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_wav_recorder_stop(esp_wav_recorder_t hdl)
+{
+    if (!hdl)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_recorder *rec = (struct esp_wav_recorder *)hdl;
+
+    if (!rec->f)
+        return ESP_ERR_INVALID_STATE;
+
+    rec->stop_request = true;
+    xSemaphoreTake(rec->done, portMAX_DELAY);
+    return rec->write_err;
+}
+
+esp_err_t esp_wav_recorder_get_stats(esp_wav_recorder_t hdl, esp_wav_recorder_stats_t *stats)
+{
+    if (!hdl || !stats)
+        return ESP_ERR_INVALID_ARG;
+
+    struct esp_wav_recorder *rec = (struct esp_wav_recorder *)hdl;
+    *stats = rec->stats;
+    return ESP_OK;
+}
+
+static size_t rec_capture(struct esp_wav_recorder *rec, void *buf, size_t len)
+{
+    size_t got = 0;
+
+    if (rec->capture)
+        return rec->capture(buf, len, rec->capture_arg);
+
+    i2s_read(rec->i2s_num, buf, len, &got, portMAX_DELAY);
+    return got;
+}
+
+// hand the pre-trigger audio to the writer, oldest first
+static void ring_flush(struct esp_wav_recorder *rec)
+{
+    rec_item_t item = { .release = false };
+
+    if (rec->ring_full) {
+        item.data = rec->ring + rec->ring_pos;
+        item.len = rec->ring_size - rec->ring_pos;
+        xQueueSend(rec->full_q, &item, portMAX_DELAY);
+    }
+    if (rec->ring_pos) {
+        item.data = rec->ring;
+        item.len = rec->ring_pos;
+        xQueueSend(rec->full_q, &item, portMAX_DELAY);
+    }
+}
+
+static void ring_capture(struct esp_wav_recorder *rec)
+{
+    size_t n = rec->ring_size - rec->ring_pos;
+
+    if (n > rec->chunk)
+        n = rec->chunk;
+
+    rec->ring_pos += rec_capture(rec, rec->ring + rec->ring_pos, n);
+    if (rec->ring_pos >= rec->ring_size) {
+        rec->ring_pos = 0;
+        rec->ring_full = true;
+    }
+}
+
+/*
+ * Capture side of the double buffer: fill one transfer buffer while the
+ * writer stores the other. If the writer still holds the other buffer when
+ * this one is full, the writer did not keep up and the buffer is dropped,
+ * rather than letting the I2S DMA overflow while waiting for the card.
+ */
+static void rec_capture_task(void *arg)
+{
+    struct esp_wav_recorder *rec = arg;
+    uint8_t                 *cur = NULL;
+    size_t                   fill = 0;
+    bool                     recording = false;
+
+    xQueueReceive(rec->free_q, &cur, portMAX_DELAY);
+
+    while (1) {
+        if (rec->start_request) {
+            rec->start_request = false;
+            ring_flush(rec);
+            rec->ring_pos = 0;
+            rec->ring_full = false;
+            fill = 0;
+            recording = true;
+        }
+
+        if (!recording) {
+            if (rec->ring)
+                ring_capture(rec);
+            else
+                rec_capture(rec, cur, rec->chunk); // keep the DMA drained
+            continue;
+        }
+
+        if (rec->stop_request) {
+            rec_item_t item = { .data = cur, .len = fill, .release = true };
+
+            if (fill) {
+                xQueueSend(rec->full_q, &item, portMAX_DELAY);
+                cur = NULL;
+            }
+            item.data = NULL;
+            xQueueSend(rec->full_q, &item, portMAX_DELAY);
+            xSemaphoreTake(rec->flushed, portMAX_DELAY);
+            if (!cur)
+                xQueueReceive(rec->free_q, &cur, portMAX_DELAY);
+
+            recording = false;
+            rec->stop_request = false;
+            xSemaphoreGive(rec->done);
+            continue;
+        }
+
+        size_t n = rec->buf_size - fill;
+        if (n > rec->chunk)
+            n = rec->chunk;
+        fill += rec_capture(rec, cur + fill, n);
+        if (fill < rec->buf_size)
+            continue;
+
+        uint8_t *next;
+        if (xQueueReceive(rec->free_q, &next, 0) == pdTRUE) {
+            rec_item_t item = { .data = cur, .len = fill, .release = true };
+            xQueueSend(rec->full_q, &item, portMAX_DELAY);
+            cur = next;
+        } else {
+            rec->stats.overruns++;
+            ESP_LOGW(TAG, "overrun, %u bytes dropped", (unsigned)fill);
+        }
+        fill = 0;
+    }
+}
+
+static bool rec_fwrite(struct esp_wav_recorder *rec, const uint8_t *data, size_t len)
+{
+    int64_t  t_start = esp_timer_get_time();
+    size_t   n = fwrite(data, 1, len, rec->f);
+    uint32_t dt = esp_timer_get_time() - t_start;
+
+    if (dt > rec->stats.write_max_us)
+        rec->stats.write_max_us = dt;
+
+    rec->file_pos += n;
+    rec->stats.data_bytes += n;
+    if (n != len) {
+        ESP_LOGE(TAG, "write failed at %u", (unsigned)rec->file_pos);
+        rec->write_err = ESP_FAIL;
+        return false;
+    }
+    return true;
+}
+
+// split off a head so every following write starts on a sector boundary
+static void rec_write(struct esp_wav_recorder *rec, const uint8_t *data, size_t len)
+{
+    size_t head = (REC_SECTOR - rec->file_pos % REC_SECTOR) % REC_SECTOR;
+
+    if (rec->write_err != ESP_OK)
+        return;
+
+    if (head > len)
+        head = len;
+    if (head && !rec_fwrite(rec, data, head))
+        return;
+    if (len > head)
+        rec_fwrite(rec, data + head, len - head);
+}
+
+static void rec_finalize(struct esp_wav_recorder *rec)
+{
+    wav_header_t hdr;
+
+    // RIFF chunks are padded to an even size
+    if (rec->write_err == ESP_OK && (rec->stats.data_bytes & 1) && fputc(0, rec->f) == EOF)
+        rec->write_err = ESP_FAIL;
+
+    rec_header(rec, &hdr, rec->stats.data_bytes);
+    if (fseek(rec->f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, rec->f) != 1) {
+        ESP_LOGE(TAG, "header update failed");
+        rec->write_err = ESP_FAIL;
+    }
+    fsync(fileno(rec->f));
+    if (fclose(rec->f) != 0)
+        rec->write_err = ESP_FAIL;
+
+    ESP_LOGI(TAG, "recorded %" PRIu32 " bytes, %" PRIu32 " overruns, max write %" PRIu32 " us",
+             rec->stats.data_bytes, rec->stats.overruns, rec->stats.write_max_us);
+    rec->f = NULL;
+}
+
+static void rec_writer_task(void *arg)
+{
+    struct esp_wav_recorder *rec = arg;
+    rec_item_t               item;
+
+    while (1) {
+        if (!xQueueReceive(rec->full_q, &item, portMAX_DELAY))
+            continue;
+
+        if (!item.data) {
+            rec_finalize(rec);
+            xSemaphoreGive(rec->flushed);
+            continue;
+        }
+
+        rec_write(rec, item.data, item.len);
+        if (item.release)
+            xQueueSend(rec->free_q, &item.data, portMAX_DELAY);
+    }
+}
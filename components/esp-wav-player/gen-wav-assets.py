@@ -0,0 +1,220 @@
+#!/usr/bin/env python
+#
+# Convert a set of source WAV files to the exact format the player outputs
+# (16-bit PCM, sink sample rate and channel count), normalize their loudness
+# and emit a header with WAV_DECLARE_EMBED_LEN() declarations, so the player
+# can write them to I2S without any per-sample work.
+#
+# The loudness correction is either applied to the samples, stored in a
+# "gain" chunk of each file or put in the generated header; in the last two
+# cases the player folds it into the volume gain at track start.
+#
+# Uses the Python standard library only. See project_include.cmake for the
+# build integration.
+
+import argparse
+import math
+import operator
+import os
+import re
+import struct
+import sys
+import wave
+
+HALF_TAPS = 16  # windowed sinc half length used for resampling
+GATE_DBFS = -60.0  # blocks below this level don't count for loudness
+BLOCK_MS = 50
+GAIN_MAX_DB = 12.0  # the player's limit for a clip gain
+
+
+def db_to_lin(db):
+    return 10.0 ** (db / 20.0)
+
+
+def lin_to_db(v):
+    return 20.0 * math.log10(v) if v > 0 else -math.inf
+
+
+def read_wav(path):
+    with wave.open(path, "rb") as w:
+        ch = w.getnchannels()
+        width = w.getsampwidth()
+        rate = w.getframerate()
+        raw = w.readframes(w.getnframes())
+
+    count = len(raw) // width
+    if width == 1:
+        samples = [(b - 128) / 128.0 for b in raw]
+    elif width == 2:
+        samples = [s / 32768.0 for s in struct.unpack("<%dh" % count, raw)]
+    elif width == 3:
+        samples = [int.from_bytes(raw[i:i + 3], "little", signed=True) / 8388608.0 for i in range(0, len(raw), 3)]
+    elif width == 4:
+        samples = [s / 2147483648.0 for s in struct.unpack("<%di" % count, raw)]
+    else:
+        raise ValueError("%s: unsupported sample width %d" % (path, width))
+
+    return rate, [samples[c::ch] for c in range(ch)]
+
+
+# same layout rules as the player's conversion kernels
+def remix(chans, out_ch):
+    if len(chans) == out_ch:
+        return chans
+    if len(chans) == 1:
+        return [chans[0]] * out_ch
+
+    groups = [chans] if out_ch == 1 else [chans[0::2], chans[1::2]]
+    return [[sum(s) / len(g) for s in zip(*g)] for g in groups]
+
+
+def sinc(x):
+    return 1.0 if x == 0 else math.sin(math.pi * x) / (math.pi * x)
+
+
+# polyphase windowed sinc, one kernel per output phase
+def resample(x, rate_in, rate_out):
+    if rate_in == rate_out:
+        return x
+
+    g = math.gcd(rate_in, rate_out)
+    up, down = rate_out // g, rate_in // g
+    cutoff = min(1.0, up / down) * 0.95
+    kernels = []
+    for p in range(up):
+        frac = p / up
+        k = [
+            cutoff * sinc(cutoff * (t - frac)) * (0.5 + 0.5 * math.cos(math.pi * (t - frac) / HALF_TAPS))
+            for t in range(-HALF_TAPS + 1, HALF_TAPS + 1)
+        ]
+        norm = sum(k)
+        kernels.append([v / norm for v in k])
+
+    pad = [0.0] * HALF_TAPS
+    xp = pad + x + pad
+    out_len = len(x) * up // down
+    y = []
+    for n in range(out_len):
+        i, p = divmod(n * down, up)
+        y.append(sum(map(operator.mul, xp[i + 1:i + 1 + 2 * HALF_TAPS], kernels[p])))
+    return y
+
+
+def loudness(chans, rate):
+    block = max(1, rate * BLOCK_MS // 1000)
+    gate = db_to_lin(GATE_DBFS) ** 2
+    total, count = 0.0, 0
+
+    for start in range(0, len(chans[0]), block):
+        e = sum(sum(v * v for v in c[start:start + block]) for c in chans)
+        n = sum(len(c[start:start + block]) for c in chans)
+        if n and e / n > gate:
+            total += e
+            count += n
+    return lin_to_db(math.sqrt(total / count)) if count else -math.inf
+
+
+def symbol_name(filename):
+    # same mangling as target_add_binary_data()
+    return re.sub(r"[^A-Za-z0-9]", "_", filename)
+
+
+def convert(path, out_dir, args):
+    rate, chans = read_wav(path)
+    chans = remix(chans, args.channels)
+    chans = [resample(c, rate, args.rate) for c in chans]
+
+    peak = max((abs(v) for c in chans for v in c), default=0.0)
+    gain_db = args.gain
+    if args.loudness is not None:
+        level = loudness(chans, args.rate)
+        if level > -math.inf:
+            gain_db += args.loudness - level
+    if peak and lin_to_db(peak) + gain_db > args.peak:
+        print("%s: gain limited by peak to %.1f dB" % (path, args.peak - lin_to_db(peak)), file=sys.stderr)
+        gain_db = args.peak - lin_to_db(peak)
+
+    if args.gain_mode != "apply":
+        gain_db = min(gain_db, GAIN_MAX_DB)
+    g = db_to_lin(gain_db) if args.gain_mode == "apply" else 1.0
+    frames = bytearray()
+    for frame in zip(*chans):
+        for v in frame:
+            frames += struct.pack("<h", max(-32768, min(32767, int(round(v * g * 32768.0)))))
+
+    name = os.path.basename(path)
+    out = os.path.join(out_dir, name)
+    write_wav(out, args.rate, args.channels, bytes(frames), gain_db if args.gain_mode == "chunk" else None)
+    return name, os.path.getsize(out), gain_db
+
+
+# canonical layout, with the "gain" chunk (see wav_header.h) between fmt and data
+def write_wav(path, rate, channels, data, gain_db):
+    align = channels * 2
+    chunks = b"fmt " + struct.pack("<IHHIIHH", 16, 1, channels, rate, rate * align, align, 16)
+    if gain_db is not None:
+        chunks += b"gain" + struct.pack("<Ihh", 4, int(round(gain_db * 100)), 0)
+    chunks += b"data" + struct.pack("<I", len(data)) + data
+    if len(data) & 1:
+        chunks += b"\0"
+
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", 4 + len(chunks)) + b"WAVE" + chunks)
+
+
+def declare(obj, sym, gain_db):
+    if gain_db is None:
+        return "WAV_DECLARE_EMBED_LEN(wav_%s, _binary_%s_start, WAV_ASSET_%s_LEN);" % (obj, sym, obj.upper())
+    return "WAV_DECLARE_EMBED_GAIN(wav_%s, _binary_%s_start, WAV_ASSET_%s_LEN, %.2ff);" % (
+        obj,
+        sym,
+        obj.upper(),
+        gain_db,
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert WAV assets to the player output format")
+    parser.add_argument("inputs", nargs="+", help="source WAV files")
+    parser.add_argument("-o", "--out-dir", required=True, help="directory for converted files and the header")
+    parser.add_argument("--header", default="wav_assets.h", help="name of the generated header")
+    parser.add_argument("--rate", type=int, default=22050, help="output sample rate")
+    parser.add_argument("--channels", type=int, choices=(1, 2), default=2, help="output channels")
+    parser.add_argument("--loudness", type=float, default=-18.0, help="target gated RMS level in dBFS")
+    parser.add_argument("--no-normalize", dest="loudness", action="store_const", const=None)
+    parser.add_argument("--gain", type=float, default=0.0, help="extra gain in dB, e.g. the playback volume")
+    parser.add_argument("--peak", type=float, default=-1.0, help="peak ceiling in dBFS")
+    parser.add_argument(
+        "--gain-mode",
+        choices=("apply", "chunk", "index"),
+        default="apply",
+        help="scale the samples, or store the gain in a 'gain' chunk or in the header",
+    )
+    args = parser.parse_args()
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    lines = [
+        "/* Generated by gen-wav-assets.py, do not edit */",
+        "#pragma once",
+        "",
+        "#include <wav_object.h>",
+        "",
+    ]
+    for path in sorted(args.inputs):
+        name, size, gain_db = convert(path, args.out_dir, args)
+        sym = symbol_name(name)
+        obj = re.sub(r"_wav$", "", sym).lower()
+        lines += [
+            "/* %s: %d Hz, %d ch, %+.1f dB */" % (name, args.rate, args.channels, gain_db),
+            "extern const uint8_t _binary_%s_start[];" % sym,
+            "#define WAV_ASSET_%s_LEN %d" % (obj.upper(), size),
+            declare(obj, sym, gain_db if args.gain_mode == "index" else None),
+            "",
+        ]
+
+    with open(os.path.join(args.out_dir, args.header), "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
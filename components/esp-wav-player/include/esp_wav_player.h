@@ -6,7 +6,9 @@
 #include "freertos/queue.h"
 #include "driver/gpio.h"
 #include "driver/i2s.h"
+#include "esp_event.h"
 #include "wav_object.h"
+#include "wav_dsp.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,9 +27,50 @@ extern "C" {
  */
 typedef void *esp_wav_player_t;
 
+/**
+ * @brief Maximum number of DSP stages that can be registered on one player.
+ */
+#define ESP_WAV_PLAYER_MAX_STAGES 4
+
+/**
+ * @brief Maximum number of output zones of one player.
+ */
+#define ESP_WAV_PLAYER_MAX_ZONES 2
+
+/**
+ * @brief Event base of the events posted by WAV players.
+ */
+ESP_EVENT_DECLARE_BASE(ESP_WAV_PLAYER_EVENT);
+
+/**
+ * @brief WAV player event IDs, posted with `esp_wav_player_event_data_t`.
+ */
+typedef enum {
+    ESP_WAV_PLAYER_EVENT_START,    /*!< Track started playing. */
+    ESP_WAV_PLAYER_EVENT_END,      /*!< Track finished or was stopped. */
+    ESP_WAV_PLAYER_EVENT_PROGRESS, /*!< Periodic position update, see `progress_interval_ms`. */
+    ESP_WAV_PLAYER_EVENT_UNDERRUN, /*!< Output ran dry before the next buffer was written. */
+    ESP_WAV_PLAYER_EVENT_ERROR,    /*!< Track could not be opened, parsed or read. */
+} esp_wav_player_event_t;
+
+/**
+ * @brief Data attached to every `ESP_WAV_PLAYER_EVENT` event.
+ */
+typedef struct {
+    esp_wav_player_t player;      /*!< Player that posted the event. */
+    uint32_t         position_ms; /*!< Position in the current track. */
+    uint32_t         duration_ms; /*!< Duration of the current track, 0 if unknown. */
+    esp_err_t        error;       /*!< Error code for `ESP_WAV_PLAYER_EVENT_ERROR`, ESP_OK otherwise. */
+    int64_t          start_us;    /*!< Estimated time the first sample reached the output (esp_timer),
+                                       for tracks started by `esp_wav_player_play_at()`, 0 otherwise. */
+} esp_wav_player_event_data_t;
+
 /**
  * @brief Callback invoked for WAV player events (start/end).
  *
+ * Callbacks are dispatched from the event loop task, never from the player
+ * task, so a slow callback cannot stall playback.
+ *
  * @param wav_player Handle to the WAV player instance that generated the event.
  * @param arg User-provided argument (set when registering the callback).
  */
@@ -42,6 +85,75 @@ typedef enum {
     ESP_WAV_PLAYER_PAUSED   /*!< Playback is paused. */
 } esp_wav_player_state_t;
 
+/**
+ * @brief How the player is driven.
+ */
+typedef enum {
+    ESP_WAV_PLAYER_MODE_TASK,        /*!< A dedicated FreeRTOS task plays queued tracks (default). */
+    ESP_WAV_PLAYER_MODE_COOPERATIVE, /*!< No task: the application calls `esp_wav_player_process()`. */
+} esp_wav_player_mode_t;
+
+/**
+ * @brief Level meter snapshot of the last buffer sent to I2S.
+ *
+ * Levels are measured after the volume gain, before the DSP stages, and are
+ * scaled to 16-bit full scale (32767) for both 8-bit and 16-bit tracks.
+ */
+typedef struct {
+    uint32_t peak;    /*!< Peak absolute sample value. */
+    uint32_t rms;     /*!< RMS level, computed from `sum_sq` by `esp_wav_player_get_meter`. */
+    uint64_t sum_sq;  /*!< Sum of squared samples. */
+    uint32_t samples; /*!< Number of samples the values were accumulated over. */
+    uint32_t clipped; /*!< Number of samples saturated by the gain. */
+    uint32_t seq;     /*!< Buffer counter, increments on every published snapshot. */
+} esp_wav_player_meter_t;
+
+/**
+ * @brief Playback position, see `esp_wav_player_get_position()`.
+ */
+typedef struct {
+    int64_t  frame;       /*!< Index of the track frame being output at `time_us`; negative while the
+                               silence before a scheduled start is still playing. */
+    int64_t  time_us;     /*!< Time (`esp_timer_get_time()`) the position refers to. */
+    uint32_t sample_rate; /*!< Sample rate of the track, to convert frames to time. */
+} esp_wav_player_position_t;
+
+/**
+ * @brief Buffering parameters in use, see `esp_wav_player_get_buffering()`.
+ */
+typedef struct {
+    size_t   chunk_size;    /*!< Bytes read from the source per transfer. */
+    int      dma_buf_count; /*!< Number of I2S DMA buffers. */
+    int      dma_buf_len;   /*!< Frames per I2S DMA buffer. */
+    uint32_t read_avg_us;   /*!< Average read latency of the current source type. */
+    uint32_t read_peak_us;  /*!< Peak (slowly decaying) read latency of the current source type. */
+    uint32_t underruns;     /*!< Underruns detected since init. */
+} esp_wav_player_buffering_t;
+
+/**
+ * @brief Idle power state and wake-up timing, see `esp_wav_player_get_power()`.
+ */
+typedef struct {
+    bool     idle;        /*!< I2S clocks are stopped until the next track. */
+    uint32_t idle_stops;  /*!< Number of times the output went idle since init. */
+    uint32_t wake_us;     /*!< Last wake-up: from leaving idle to the first sample written to the DMA. */
+    uint32_t wake_max_us; /*!< Longest wake-up since init. */
+} esp_wav_player_power_t;
+
+/**
+ * @brief One I2S output of a player, see `zones` in `esp_wav_player_config_t`.
+ *
+ * All zones get the same audio from a single decode; only the gain and the
+ * delay differ. Every zone uses the `base_cfg` I2S configuration.
+ */
+typedef struct {
+    int              i2s_num;        /*!< I2S peripheral number (e.g. `I2S_NUM_1`). */
+    i2s_pin_config_t i2s_pin_config; /*!< I2S pin mapping of this zone. */
+    float            gain_db;        /*!< Zone gain, 0 or negative, on top of the player volume. */
+    uint32_t         delay_us;       /*!< Delay of this zone, to align speakers at different distances.
+                                          Limited to the DMA depth minus one DMA buffer. */
+} esp_wav_player_zone_t;
+
 /**
  * @brief Configuration structure used to initialize a WAV player instance.
  *
@@ -49,10 +161,29 @@ typedef enum {
  * I2S peripheral behaviour; defaults are provided by `ESP_WAV_PLAYER_DEFAULT_CONFIG()`.
  */
 typedef struct {
-    int              i2s_num;        /*!< I2S peripheral number (e.g. `I2S_NUM_0`). */
-    i2s_pin_config_t i2s_pin_config; /*!< I2S pin mapping used to route signals to GPIOs. */
-    i2s_config_t     base_cfg;       /*!< Base I2S runtime configuration (sample rate, format, buffers). */
+    int              i2s_num;        /*!< I2S peripheral number (e.g. `I2S_NUM_0`), unused with `zones`. */
+    i2s_pin_config_t i2s_pin_config; /*!< I2S pin mapping used to route signals to GPIOs, unused with `zones`. */
+    i2s_config_t     base_cfg;       /*!< Base I2S runtime configuration (sample rate, format, buffers).
+                                          Output is 16-bit; `channel_format` selects a mono or stereo sink. */
     size_t           queue_len;      /*!< Queue length for internal command/notification queue. */
+
+    esp_wav_player_mode_t mode;     /*!< Task or cooperative mode. */
+    size_t                buf_size; /*!< Size of the transfer buffer in bytes, 0 for the default (1024). */
+
+    bool adaptive_buffering; /*!< Pick chunk size and DMA depth from measured source read latency. */
+    int  dma_buf_count_max;  /*!< Upper limit of `dma_buf_count` in adaptive mode, 0 for 2x `base_cfg`. */
+
+    uint32_t crossfade_ms; /*!< Overlap between consecutive tracks of the same format, 0 to disable.
+                                Doubles the transfer buffer memory. */
+
+    esp_wav_player_zone_t zones[ESP_WAV_PLAYER_MAX_ZONES]; /*!< Outputs fed from one decode. */
+    size_t                num_zones; /*!< Number of `zones` used; 0 for a single output on `i2s_num`. */
+
+    uint32_t idle_stop_ms; /*!< Stop the I2S clocks after this long without a track, 0 to keep them running.
+                                Allows light sleep while idle when power management is enabled. */
+
+    esp_event_loop_handle_t event_loop;           /*!< Loop events are posted to, NULL for the default loop. */
+    uint32_t                progress_interval_ms; /*!< Interval of PROGRESS events in audio time, 0 to disable. */
 } esp_wav_player_config_t;
 
 #if CONFIG_IDF_TARGET_ESP8266
@@ -122,6 +253,23 @@ typedef struct {
  */
 esp_err_t esp_wav_player_init(esp_wav_player_t *player, const esp_wav_player_config_t *config);
 
+/**
+ * @brief Drive a cooperative-mode player from the application loop.
+ *
+ * Moves up to `budget` frames of audio from the source to I2S without
+ * blocking: when the I2S DMA is full the call returns and the remaining
+ * data is written on the next call. Starts the next queued track when idle.
+ * Call it often enough that the DMA never drains, i.e. at least once per
+ * `dma_buf_count * dma_buf_len` frames of audio.
+ *
+ * @param player Player initialized with `ESP_WAV_PLAYER_MODE_COOPERATIVE`.
+ * @param budget Maximum number of frames to move in this call.
+ * @return
+ *     - ESP_OK on success, also when there is nothing to play
+ *     - ESP_ERR_INVALID_STATE if the player runs its own task
+ */
+esp_err_t esp_wav_player_process(esp_wav_player_t player, size_t budget);
+
 /**
  * @brief Deinitialize and free a WAV player instance.
  *
@@ -142,6 +290,26 @@ esp_err_t esp_wav_player_deinit(esp_wav_player_t hdl);
  */
 esp_err_t esp_wav_player_play(esp_wav_player_t player, const wav_obj_t *src);
 
+/**
+ * @brief Queue a WAV source to start at a given time.
+ *
+ * Intended for starting playback on several devices at the same instant
+ * (with synchronized `esp_timer` clocks). The player opens the track early,
+ * fills the I2S DMA with silence and pads it so that the first sample hits
+ * the output at `start_us`. The achieved estimate is reported in the
+ * `start_us` field of the START event. If the player reaches the track
+ * after `start_us` (previous track still playing), it starts immediately.
+ *
+ * @param player Initialized player handle, in task mode.
+ * @param src Pointer to a `wav_obj_t` describing the WAV data to play.
+ * @param start_us Target start time, in `esp_timer_get_time()` microseconds.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_NOT_SUPPORTED in cooperative mode
+ *     - ESP_FAIL if the source can't be created or the queue is full
+ */
+esp_err_t esp_wav_player_play_at(esp_wav_player_t player, const wav_obj_t *src, int64_t start_us);
+
 /**
  * @brief Stop playback immediately.
  *
@@ -185,9 +353,32 @@ esp_err_t esp_wav_player_set_volume(esp_wav_player_t player, uint8_t v);
  */
 esp_err_t esp_wav_player_get_volume(esp_wav_player_t hdl, uint8_t *vol);
 
+/**
+ * @brief Get the idle power state and the measured wake-up time.
+ *
+ * @param hdl Player handle.
+ * @param[out] info Pointer to receive the power state.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_player_get_power(esp_wav_player_t hdl, esp_wav_player_power_t *info);
+
+/**
+ * @brief Set the gain of one output zone.
+ *
+ * Takes effect with the next buffer written.
+ *
+ * @param hdl Player handle.
+ * @param zone Zone index in the `zones` configuration (0 for a single-output player).
+ * @param gain_db Gain in dB, 0 or negative; positive values are treated as 0.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown zone.
+ */
+esp_err_t esp_wav_player_set_zone_gain(esp_wav_player_t hdl, size_t zone, float gain_db);
+
 /**
  * @brief Get number of queued items in the player's internal queue.
  *
+ * A track already opened ahead of a crossfade still counts as queued.
+ *
  * @param hdl Player handle.
  * @param[out] qlen Pointer to receive queued count.
  * @return ESP_OK on success, otherwise an `esp_err_t` error code.
@@ -197,6 +388,9 @@ esp_err_t esp_wav_player_get_queued(esp_wav_player_t hdl, size_t *qlen);
 /**
  * @brief Register a callback invoked when playback starts.
  *
+ * The callback runs in the event loop task; this requires the configured
+ * event loop (the default loop unless `event_loop` is set) to exist.
+ *
  * @param player Player handle.
  * @param cb Callback function or NULL to clear.
  * @param arg User argument passed to the callback.
@@ -206,12 +400,97 @@ void esp_wav_player_set_start_cb(esp_wav_player_t player, esp_wav_player_cb_t cb
 /**
  * @brief Register a callback invoked when playback ends.
  *
+ * The callback runs in the event loop task; this requires the configured
+ * event loop (the default loop unless `event_loop` is set) to exist.
+ *
  * @param player Player handle.
  * @param cb Callback function or NULL to clear.
  * @param arg User argument passed to the callback.
  */
 void esp_wav_player_set_end_cb(esp_wav_player_t player, esp_wav_player_cb_t cb, void *arg);
 
+/**
+ * @brief Get the frame currently being output, for audio-visual sync.
+ *
+ * The position is derived from the frames handed to I2S minus the audio
+ * still queued in the DMA buffers (`dma_buf_count * dma_buf_len`), so it
+ * follows what is actually heard rather than what was last written. It is
+ * updated by the output path on every write and read lock-free, so it can
+ * be polled from any task at frame rate. A caller that preempted the player
+ * task in the middle of an update sleeps a tick to let it finish.
+ *
+ * @param player Player handle.
+ * @param[out] pos Pointer to receive the position.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if no track is playing
+ *     - ESP_ERR_TIMEOUT if the position was being updated on every attempt
+ */
+esp_err_t esp_wav_player_get_position(esp_wav_player_t player, esp_wav_player_position_t *pos);
+
+/**
+ * @brief Get the buffering parameters currently in use.
+ *
+ * With `adaptive_buffering` enabled the player measures the read latency of
+ * each source type and, at track start, picks the chunk size (up to
+ * `buf_size`) and the DMA buffer count (up to `dma_buf_count_max`) needed to
+ * ride out the slowest reads without underruns.
+ *
+ * @param player Player handle.
+ * @param[out] info Pointer to receive the parameters.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_player_get_buffering(esp_wav_player_t player, esp_wav_player_buffering_t *info);
+
+/**
+ * @brief Enable or disable level metering.
+ *
+ * When enabled, peak and sum-of-squares are accumulated in the same loop
+ * that applies the volume, and a snapshot is published for every buffer.
+ *
+ * @param player Player handle.
+ * @param enable true to enable metering; takes effect with the next track.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_player_set_metering(esp_wav_player_t player, bool enable);
+
+/**
+ * @brief Get the latest level meter snapshot.
+ *
+ * Lock-free: safe to call from any task at any rate, it never blocks the
+ * player task. Compare `seq` with the previous call to detect new data.
+ *
+ * @param player Player handle.
+ * @param[out] meter Pointer to receive the snapshot.
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the snapshot was being updated on every attempt.
+ */
+esp_err_t esp_wav_player_get_meter(esp_wav_player_t player, esp_wav_player_meter_t *meter);
+
+/**
+ * @brief Append a processing stage to the player's DSP chain.
+ *
+ * Stages run in registration order on every buffer, after the volume gain.
+ * The chain is validated once per track: stages whose `formats` do not match
+ * the track, or whose `prepare` fails, are skipped for that track.
+ *
+ * @param player Player handle.
+ * @param stage Stage descriptor; must stay valid while registered.
+ * @param ctx Stage state passed to the stage callbacks.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if the player is not stopped
+ *     - ESP_ERR_NO_MEM if `ESP_WAV_PLAYER_MAX_STAGES` stages are already registered
+ */
+esp_err_t esp_wav_player_add_stage(esp_wav_player_t player, const wav_dsp_stage_t *stage, void *ctx);
+
+/**
+ * @brief Remove all stages from the player's DSP chain.
+ *
+ * @param player Player handle.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the player is not stopped.
+ */
+esp_err_t esp_wav_player_clear_stages(esp_wav_player_t player);
+
 #ifdef __cplusplus
 }
 #endif
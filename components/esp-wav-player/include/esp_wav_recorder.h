@@ -0,0 +1,182 @@
+#ifndef _ESP_WAV_RECORDER_H_
+#define _ESP_WAV_RECORDER_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "driver/i2s.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file esp_wav_recorder.h
+ * @brief I2S capture to WAV file recorder.
+ *
+ * A capture task moves audio from the I2S DMA into one of two transfer
+ * buffers while a writer task stores the other one to the file, so a slow
+ * SD card write does not stall the capture. The WAV header is written when
+ * the recording starts and patched with the final sizes when it stops.
+ */
+
+/**
+ * @brief Opaque handle for a WAV recorder instance.
+ */
+typedef void *esp_wav_recorder_t;
+
+/**
+ * @brief Capture source used instead of I2S, e.g. a synthetic signal for testing.
+ *
+ * Must block until `len` bytes in the format described by `base_cfg` are
+ * available, like `i2s_read()` does, and return the number of bytes copied.
+ *
+ * @param buf Destination buffer.
+ * @param len Number of bytes requested, always a multiple of the frame size.
+ * @param arg User argument from the configuration.
+ */
+typedef size_t (*esp_wav_recorder_capture_t)(void *buf, size_t len, void *arg);
+
+/**
+ * @brief Recording statistics, see `esp_wav_recorder_get_stats()`.
+ */
+typedef struct {
+    uint32_t data_bytes;   /*!< Audio bytes written to the current (or last) file. */
+    uint32_t overruns;     /*!< Buffers dropped because the writer did not keep up. */
+    uint32_t write_max_us; /*!< Longest single file write. */
+} esp_wav_recorder_stats_t;
+
+/**
+ * @brief Configuration structure used to initialize a WAV recorder instance.
+ *
+ * The file format (sample rate, bits per sample, channels) is taken from
+ * `base_cfg` also when a custom `capture` source is used.
+ */
+typedef struct {
+    int              i2s_num;        /*!< I2S peripheral number (e.g. `I2S_NUM_0`). */
+    i2s_pin_config_t i2s_pin_config; /*!< I2S pin mapping of the microphone. */
+    i2s_config_t     base_cfg;       /*!< I2S RX configuration, also defines the WAV format. */
+
+    esp_wav_recorder_capture_t capture;     /*!< Capture source, NULL to read from I2S. */
+    void                      *capture_arg; /*!< Argument passed to `capture`. */
+
+    size_t   buf_size;      /*!< Size of each of the two transfer buffers, rounded up to 512 bytes;
+                                 0 for the default (8 kB). */
+    uint32_t pretrigger_ms; /*!< Audio kept from before `esp_wav_recorder_start()`, 0 to disable. */
+} esp_wav_recorder_config_t;
+
+#if CONFIG_IDF_TARGET_ESP8266
+/**
+ * @brief Default configuration for ESP8266 targets: 16 kHz, 16-bit mono.
+ */
+#define ESP_WAV_RECORDER_DEFAULT_CONFIG() \
+    {                                                                          \
+    .i2s_num = I2S_NUM_0,                                                      \
+    .i2s_pin_config = {                                                        \
+        .bck_o_en = 1,                                                         \
+        .ws_o_en = 1,                                                          \
+        .data_in_en = 1,                                                       \
+    },                                                                         \
+    .base_cfg = {                                                              \
+        .mode = I2S_MODE_MASTER | I2S_MODE_RX,                                 \
+        .sample_rate = 16000,                                                  \
+        .bits_per_sample = 16,                                                 \
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,                           \
+        .communication_format = I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_LSB, \
+        .dma_buf_count = 4,                                                    \
+        .dma_buf_len = 256,                                                    \
+    },                                                                         \
+}
+#else
+/**
+ * @brief Default configuration for non-ESP8266 targets: 16 kHz, 16-bit mono.
+ *
+ * The example mapping uses `.bck_io_num = GPIO_NUM_26`, `.ws_io_num = GPIO_NUM_27`
+ * and `.data_in_num = GPIO_NUM_35`.
+ */
+#define ESP_WAV_RECORDER_DEFAULT_CONFIG() \
+    {                                                      \
+    .i2s_num = I2S_NUM_1,                                  \
+    .i2s_pin_config = {                                    \
+        .bck_io_num = GPIO_NUM_26,                         \
+        .ws_io_num = GPIO_NUM_27,                          \
+        .data_out_num = I2S_PIN_NO_CHANGE,                 \
+        .data_in_num = GPIO_NUM_35,                        \
+    },                                                     \
+    .base_cfg = {                                          \
+        .mode = I2S_MODE_MASTER | I2S_MODE_RX,             \
+        .sample_rate = 16000,                              \
+        .bits_per_sample = 16,                             \
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,       \
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S, \
+        .dma_buf_count = 4,                                \
+        .dma_buf_len = 256,                                \
+    },                                                     \
+}
+#endif
+
+/**
+ * @brief Initialize a WAV recorder instance.
+ *
+ * Installs the I2S driver (unless a custom `capture` source is configured)
+ * and starts capturing. Audio is discarded, or kept in the pre-trigger
+ * buffer, until a recording is started.
+ *
+ * @param[out] rec Pointer that will receive the allocated recorder handle on success.
+ * @param[in] config Pointer to configuration, see `ESP_WAV_RECORDER_DEFAULT_CONFIG()`.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_recorder_init(esp_wav_recorder_t *rec, const esp_wav_recorder_config_t *config);
+
+/**
+ * @brief Deinitialize a recorder, finishing a recording in progress.
+ *
+ * @param rec Recorder handle.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_recorder_deinit(esp_wav_recorder_t rec);
+
+/**
+ * @brief Start recording to a new file.
+ *
+ * The file is created and the WAV header written before the call returns.
+ * With `pretrigger_ms` set, the recording begins with the audio captured
+ * just before this call.
+ *
+ * @param rec Recorder handle.
+ * @param path Path of the file to create (e.g. "/sdcard/rec0001.wav").
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if a recording is already in progress
+ *     - ESP_FAIL if the file could not be created
+ */
+esp_err_t esp_wav_recorder_start(esp_wav_recorder_t rec, const char *path);
+
+/**
+ * @brief Stop recording and finalize the file.
+ *
+ * Blocks until the buffered audio is written, the header is patched with
+ * the final sizes and the file is closed.
+ *
+ * @param rec Recorder handle.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_STATE if no recording is in progress
+ *     - ESP_FAIL if writing the file failed at any point
+ */
+esp_err_t esp_wav_recorder_stop(esp_wav_recorder_t rec);
+
+/**
+ * @brief Get recording statistics.
+ *
+ * @param rec Recorder handle.
+ * @param[out] stats Pointer to receive the statistics.
+ * @return ESP_OK on success, otherwise an `esp_err_t` error code.
+ */
+esp_err_t esp_wav_recorder_get_stats(esp_wav_recorder_t rec, esp_wav_recorder_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ESP_WAV_RECORDER_H_
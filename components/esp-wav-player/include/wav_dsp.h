@@ -0,0 +1,117 @@
+#ifndef _WAV_DSP_H_
+#define _WAV_DSP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file wav_dsp.h
+ * @brief In-place per-buffer processing stages for the WAV player.
+ *
+ * A stage is a set of callbacks plus a user-owned state pointer. Stages are
+ * registered on a player with `esp_wav_player_add_stage()` and run in
+ * registration order on every buffer, after the volume gain and before the
+ * buffer is written to I2S. Stages see the player output format: 16-bit
+ * samples with the channel count of the I2S sink, whatever the track format.
+ */
+
+/**
+ * @brief Format flags a stage uses to declare what it can process.
+ *
+ * Stages always get signed 16-bit samples, so only the channel count is
+ * declared. A stage supports a track when one flag matches the channel count
+ * of the I2S sink. The check is done once per track.
+ */
+#define WAV_DSP_FMT_MONO   (1 << 0) /*!< Single channel. */
+#define WAV_DSP_FMT_STEREO (1 << 1) /*!< Two interleaved channels. */
+
+#define WAV_DSP_FMT_ANY (WAV_DSP_FMT_MONO | WAV_DSP_FMT_STEREO)
+
+/**
+ * @brief Format of the samples handed to a stage.
+ */
+typedef struct {
+    uint32_t sample_rate;  /*!< Sampling rate in Hz. */
+    uint16_t bit_depth;    /*!< Bits per sample, always 16. */
+    uint16_t num_channels; /*!< Number of interleaved channels. */
+} wav_dsp_format_t;
+
+/**
+ * @brief Processing stage descriptor.
+ *
+ * Descriptors are usually `static const`; per-instance state is passed as
+ * `ctx` when registering the stage.
+ */
+typedef struct {
+    const char *name;    /*!< Short name used in log messages. */
+    uint32_t    formats; /*!< Mask of `WAV_DSP_FMT_*` flags the stage supports. */
+
+    /**
+     * Optional. Called once at track start with the track format, before any
+     * `process` call. Returning an error skips the stage for this track.
+     */
+    esp_err_t (*prepare)(void *ctx, const wav_dsp_format_t *fmt);
+
+    /**
+     * Process `samples` interleaved samples in place. Called from the player
+     * task on every buffer, so it must not block.
+     */
+    void (*process)(void *ctx, void *buf, size_t samples);
+} wav_dsp_stage_t;
+
+/**
+ * @brief Biquad filter response.
+ */
+typedef enum {
+    WAV_BIQUAD_LOWPASS,   /*!< 2nd order low-pass. */
+    WAV_BIQUAD_HIGHPASS,  /*!< 2nd order high-pass. */
+    WAV_BIQUAD_PEAKING,   /*!< Peaking EQ band, uses `gain_db`. */
+    WAV_BIQUAD_LOWSHELF,  /*!< Low shelf, uses `gain_db`. */
+    WAV_BIQUAD_HIGHSHELF, /*!< High shelf, uses `gain_db`. */
+} wav_biquad_type_t;
+
+/**
+ * @brief State of a fixed-point biquad stage.
+ *
+ * Fill in the public fields (or use `WAV_BIQUAD_INIT`) and register with
+ * `esp_wav_player_add_stage(player, &wav_dsp_biquad_stage, &bq)`.
+ * Coefficients are computed in `prepare` for the sample rate of each track;
+ * the per-sample path is Q28 integer arithmetic only.
+ *
+ * Q28 holds coefficients within +-8. Any frequency and Q fits with `gain_db`
+ * within +-12 dB. Larger gains fit only for some frequencies and Qs; where
+ * they do not (e.g. a +24 dB high shelf at 6 kHz, Q 0.707, 44.1 kHz),
+ * `prepare` fails with ESP_ERR_INVALID_ARG and the stage is skipped.
+ */
+typedef struct {
+    wav_biquad_type_t type;    /*!< Filter response. */
+    float             freq_hz; /*!< Corner/centre frequency in Hz. */
+    float             q;       /*!< Quality factor (0.707 for Butterworth). */
+    float             gain_db; /*!< Gain for peaking and shelf filters, see above for the range. */
+
+    /* private, filled by prepare */
+    int32_t  b0, b1, b2, a1, a2;
+    int32_t  x1[2], x2[2], y1[2], y2[2];
+    uint16_t channels;
+} wav_biquad_t;
+
+/**
+ * @brief Static initializer for `wav_biquad_t`.
+ */
+#define WAV_BIQUAD_INIT(t, f, qf, g) { .type = (t), .freq_hz = (f), .q = (qf), .gain_db = (g) }
+
+/**
+ * @brief Biquad stage descriptor (16-bit mono/stereo), `ctx` is a `wav_biquad_t *`.
+ */
+extern const wav_dsp_stage_t wav_dsp_biquad_stage;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _WAV_DSP_H_
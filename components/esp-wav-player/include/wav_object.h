@@ -15,7 +15,8 @@ extern "C" {
  *
  * This header defines a small `wav_obj_t` descriptor used to refer to WAV
  * data located in different storage backends (embedded in flash, SPIFFS,
- * or MMC/SD). Helper macros are provided to create static descriptors.
+ * or MMC/SD), or to tones generated on the fly. Helper macros are provided
+ * to create static descriptors.
  */
 
 /**
@@ -25,21 +26,35 @@ typedef enum {
     WAV_SRC_EMBED,  /*!< WAV file embedded in program memory (pointer to data). */
     WAV_SRC_SPIFFS, /*!< WAV file stored in SPIFFS filesystem (path string). */
     WAV_SRC_MMC,    /*!< WAV file stored on MMC/SD card (path string). */
+    WAV_SRC_TONE,   /*!< Tone, sweep or DTMF generated on the fly (no stored data). */
+    WAV_SRC_MAX,    /*!< Number of source types, not a valid type. */
 } wav_source_type_t;
 
+/**
+ * @brief Kind of generated tone for `WAV_SRC_TONE`.
+ */
+typedef enum {
+    WAV_TONE_SINE,  /*!< Single sine at `freq_hz`. */
+    WAV_TONE_SWEEP, /*!< Linear sweep from `freq_hz` to `freq_end_hz`. */
+    WAV_TONE_DTMF,  /*!< DTMF dual tones for each character of `digits`. */
+} wav_tone_type_t;
+
 /**
  * @brief Descriptor for a WAV resource.
  *
  * The `wav_obj_t` contains a `type` field indicating where the WAV data
  * is located and a union with storage-specific metadata. For embedded
  * data, provide a pointer to the raw WAV bytes. For SPIFFS/MMC, provide
- * the path to the file.
+ * the path to the file. `gain_db` evens out the loudness of clips from
+ * different sources; a "gain" chunk in the file adds to it.
  */
 typedef struct {
-    wav_source_type_t type; /*!< Source type selecting the active union member. */
+    wav_source_type_t type;    /*!< Source type selecting the active union member. */
+    float             gain_db; /*!< Clip gain in dB applied on top of the player volume, up to +12 dB. */
     union {
         struct {
             const uint8_t *addr; /*!< Pointer to embedded WAV data in flash/ROM. */
+            size_t         len;  /*!< Size of the data in bytes, 0 if unknown. */
         } embed;
         struct {
             const char *path; /*!< Path to WAV file inside SPIFFS. */
@@ -47,6 +62,17 @@ typedef struct {
         struct {
             const char *path; /*!< Path to WAV file on MMC/SD card. */
         } mmc;
+        struct {
+            wav_tone_type_t type;        /*!< Sine, sweep or DTMF. */
+            uint16_t        freq_hz;     /*!< Tone frequency, start frequency of a sweep. */
+            uint16_t        freq_end_hz; /*!< End frequency of a sweep. */
+            uint16_t        duration_ms; /*!< Tone length, per digit for DTMF. */
+            uint16_t        gap_ms;      /*!< Silence after each DTMF digit. */
+            uint8_t         attack_ms;   /*!< Fade-in length of each tone. */
+            uint8_t         release_ms;  /*!< Fade-out length of each tone. */
+            uint8_t         level;       /*!< Amplitude in percent of full scale, 0-100. */
+            const char     *digits;      /*!< DTMF digits: 0-9, *, #, A-D. */
+        } tone;
     };
 } wav_obj_t;
 
@@ -64,6 +90,32 @@ typedef struct {
  */
 #define WAV_DECLARE_EMBED(name, addr) static const wav_obj_t name = { .type = WAV_SRC_EMBED, .embed = { addr } }
 
+/**
+ * @brief Macro to declare an embedded WAV descriptor of known size.
+ *
+ * Reads are bounded to `size` bytes, so a truncated or corrupt header cannot
+ * run past the data. Headers generated by `gen-wav-assets.py` use this form.
+ *
+ * @param name Identifier to create (static `wav_obj_t`).
+ * @param addr Pointer to embedded WAV data.
+ * @param size Size of the data in bytes.
+ */
+#define WAV_DECLARE_EMBED_LEN(name, addr, size) \
+    static const wav_obj_t name = { .type = WAV_SRC_EMBED, .embed = { addr, size } }
+
+/**
+ * @brief Macro to declare an embedded WAV descriptor with a clip gain.
+ *
+ * Used by headers generated with `gen-wav-assets.py --gain-mode index`.
+ *
+ * @param name Identifier to create (static `wav_obj_t`).
+ * @param addr Pointer to embedded WAV data.
+ * @param size Size of the data in bytes.
+ * @param gain Clip gain in dB.
+ */
+#define WAV_DECLARE_EMBED_GAIN(name, addr, size, gain) \
+    static const wav_obj_t name = { .type = WAV_SRC_EMBED, .gain_db = (gain), .embed = { addr, size } }
+
 /**
  * @brief Macro to declare a SPIFFS WAV descriptor.
  *
@@ -80,6 +132,59 @@ typedef struct {
  */
 #define WAV_DECLARE_MMC(name, path) static const wav_obj_t name = { .type = WAV_SRC_MMC, .mmc = { path } }
 
+/**
+ * @brief Macro to declare a sine beep.
+ *
+ * Uses a 5 ms attack and release and 50% level; declare the `tone` member
+ * directly for other envelopes.
+ *
+ * @param name Identifier to create (static `wav_obj_t`).
+ * @param freq Frequency in Hz.
+ * @param ms Duration in milliseconds.
+ */
+#define WAV_DECLARE_TONE(name, freq, ms)                                                          \
+    static const wav_obj_t name = { .type = WAV_SRC_TONE,                                         \
+                                    .tone = { .type = WAV_TONE_SINE,                              \
+                                              .freq_hz = (freq),                                  \
+                                              .duration_ms = (ms),                                \
+                                              .attack_ms = 5,                                     \
+                                              .release_ms = 5,                                    \
+                                              .level = 50 } }
+
+/**
+ * @brief Macro to declare a linear frequency sweep.
+ *
+ * @param name Identifier to create (static `wav_obj_t`).
+ * @param from Start frequency in Hz.
+ * @param to End frequency in Hz.
+ * @param ms Duration in milliseconds.
+ */
+#define WAV_DECLARE_SWEEP(name, from, to, ms)                                                     \
+    static const wav_obj_t name = { .type = WAV_SRC_TONE,                                         \
+                                    .tone = { .type = WAV_TONE_SWEEP,                             \
+                                              .freq_hz = (from),                                  \
+                                              .freq_end_hz = (to),                                \
+                                              .duration_ms = (ms),                                \
+                                              .attack_ms = 5,                                     \
+                                              .release_ms = 5,                                    \
+                                              .level = 50 } }
+
+/**
+ * @brief Macro to declare a DTMF sequence, 80 ms per digit with 80 ms gaps.
+ *
+ * @param name Identifier to create (static `wav_obj_t`).
+ * @param str Digits to dial (e.g. "123#").
+ */
+#define WAV_DECLARE_DTMF(name, str)                                                               \
+    static const wav_obj_t name = { .type = WAV_SRC_TONE,                                         \
+                                    .tone = { .type = WAV_TONE_DTMF,                              \
+                                              .duration_ms = 80,                                  \
+                                              .gap_ms = 80,                                       \
+                                              .attack_ms = 2,                                     \
+                                              .release_ms = 2,                                    \
+                                              .level = 50,                                        \
+                                              .digits = (str) } }
+
 #ifdef __cplusplus
 }
 #endif
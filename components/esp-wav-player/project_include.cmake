@@ -0,0 +1,74 @@
+# esp_wav_player_add_assets
+#
+# Convert the WAV files in a directory to the player output format at build
+# time with gen-wav-assets.py, embed them in the component and generate a
+# header declaring a `wav_obj_t` for each of them.
+#
+# esp_wav_player_add_assets(<component_lib>
+#     SOURCE_DIR <dir>                 directory with the source .wav files
+#     [HEADER <name>]                  generated header, default wav_assets.h
+#     [RATE <hz>]                      output sample rate, default 22050
+#     [CHANNELS <1|2>]                 output channels, default 2
+#     [LOUDNESS <dbfs>]                loudness target, default -18
+#     [GAIN <db>]                      extra gain baked into the samples
+#     [NO_NORMALIZE])
+#
+# Use the sample rate and channel format of the player `base_cfg` so the
+# player can hand the embedded data to I2S without touching the samples.
+
+set(ESP_WAV_PLAYER_ASSETS_TOOL "${COMPONENT_DIR}/gen-wav-assets.py")
+
+function(esp_wav_player_add_assets target)
+    cmake_parse_arguments(arg "NO_NORMALIZE" "SOURCE_DIR;HEADER;RATE;CHANNELS;LOUDNESS;GAIN" "" ${ARGN})
+    idf_build_get_property(python PYTHON)
+
+    get_filename_component(src_dir "${arg_SOURCE_DIR}" ABSOLUTE)
+    file(GLOB sources "${src_dir}/*.wav")
+    if(NOT sources)
+        message(FATAL_ERROR "esp_wav_player_add_assets: no .wav files in ${src_dir}")
+    endif()
+
+    set(out_dir "${CMAKE_CURRENT_BINARY_DIR}/wav_assets")
+    set(header "wav_assets.h")
+    if(arg_HEADER)
+        set(header "${arg_HEADER}")
+    endif()
+
+    set(opts --out-dir "${out_dir}" --header "${header}")
+    if(arg_RATE)
+        list(APPEND opts --rate ${arg_RATE})
+    endif()
+    if(arg_CHANNELS)
+        list(APPEND opts --channels ${arg_CHANNELS})
+    endif()
+    if(arg_LOUDNESS)
+        list(APPEND opts --loudness ${arg_LOUDNESS})
+    endif()
+    if(arg_GAIN)
+        list(APPEND opts --gain ${arg_GAIN})
+    endif()
+    if(arg_NO_NORMALIZE)
+        list(APPEND opts --no-normalize)
+    endif()
+
+    set(outputs "${out_dir}/${header}")
+    foreach(src ${sources})
+        get_filename_component(name "${src}" NAME)
+        list(APPEND outputs "${out_dir}/${name}")
+    endforeach()
+
+    add_custom_command(OUTPUT ${outputs}
+        COMMAND ${python} "${ESP_WAV_PLAYER_ASSETS_TOOL}" ${opts} ${sources}
+        DEPENDS ${sources} "${ESP_WAV_PLAYER_ASSETS_TOOL}"
+        COMMENT "Converting WAV assets in ${src_dir}"
+        VERBATIM)
+    add_custom_target(${target}_wav_assets DEPENDS ${outputs})
+    add_dependencies(${target} ${target}_wav_assets)
+
+    foreach(out ${outputs})
+        if(out MATCHES "\\.wav$")
+            target_add_binary_data(${target} "${out}" BINARY)
+        endif()
+    endforeach()
+    target_include_directories(${target} PRIVATE "${out_dir}")
+endfunction()
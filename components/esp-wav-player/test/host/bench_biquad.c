@@ -0,0 +1,198 @@
+/*
+ * Host check and benchmark of the fixed-point biquad stage.
+ *
+ * The Q28 filter is compared with the same RBJ design run in double
+ * precision: the steady-state gain at a few frequencies must agree within
+ * 0.1 dB. Filters whose coefficients do not fit Q28 must be rejected by
+ * prepare. Then the stage is timed on player-sized buffers, next to the
+ * double-precision filter for scale. Times are for the host CPU.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wav_dsp.h"
+
+#define RATE    22050
+#define LEN     (RATE / 5) /* 200 ms, the second half is measured */
+#define SAMPLES 512        /* a 1 kB player buffer */
+#define ROUNDS  20000
+
+typedef struct {
+    const char       *name;
+    wav_biquad_type_t type;
+    float             freq_hz, q, gain_db;
+} bq_case_t;
+
+static const bq_case_t cases[] = {
+    { "lowpass 1 kHz", WAV_BIQUAD_LOWPASS, 1000, 0.707f, 0 },
+    { "highpass 200 Hz", WAV_BIQUAD_HIGHPASS, 200, 0.707f, 0 },
+    { "peaking 1 kHz +6 dB", WAV_BIQUAD_PEAKING, 1000, 1.0f, 6 },
+    { "lowshelf 300 Hz -6 dB", WAV_BIQUAD_LOWSHELF, 300, 0.707f, -6 },
+    { "highshelf 4 kHz +3 dB", WAV_BIQUAD_HIGHSHELF, 4000, 0.707f, 3 },
+};
+
+static const float probe_hz[] = { 100, 300, 1000, 3000, 8000 };
+
+// prepare must reject coefficients Q28 cannot hold (|c| >= 8), at 44.1 kHz
+static const struct {
+    bq_case_t c;
+    bool      fits;
+} range_cases[] = {
+    { { "highshelf 6 kHz +24 dB", WAV_BIQUAD_HIGHSHELF, 6000, 0.707f, 24 }, false },
+    { { "highshelf 3 kHz +24 dB", WAV_BIQUAD_HIGHSHELF, 3000, 0.707f, 24 }, false },
+    { { "highshelf 21 kHz +12 dB", WAV_BIQUAD_HIGHSHELF, 21000, 0.707f, 12 }, true },
+    { { "lowshelf 21 kHz -12 dB", WAV_BIQUAD_LOWSHELF, 21000, 5.0f, -12 }, true },
+    { { "peaking 21 kHz +12 dB", WAV_BIQUAD_PEAKING, 21000, 0.1f, 12 }, true },
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// RBJ cookbook gain of the filter at `f`, in dB
+static double ref_gain_db(const bq_case_t *c, double f)
+{
+    double A = pow(10, c->gain_db / 40), w0 = 2 * M_PI * c->freq_hz / RATE;
+    double cw = cos(w0), alpha = sin(w0) / (2 * c->q), sa = 2 * sqrt(A) * alpha;
+    double b[3], a[3];
+
+    switch (c->type) {
+    case WAV_BIQUAD_LOWPASS:
+        b[1] = 1 - cw, b[0] = b[2] = b[1] / 2;
+        a[0] = 1 + alpha, a[1] = -2 * cw, a[2] = 1 - alpha;
+        break;
+    case WAV_BIQUAD_HIGHPASS:
+        b[1] = -(1 + cw), b[0] = b[2] = (1 + cw) / 2;
+        a[0] = 1 + alpha, a[1] = -2 * cw, a[2] = 1 - alpha;
+        break;
+    case WAV_BIQUAD_PEAKING:
+        b[0] = 1 + alpha * A, b[1] = -2 * cw, b[2] = 1 - alpha * A;
+        a[0] = 1 + alpha / A, a[1] = -2 * cw, a[2] = 1 - alpha / A;
+        break;
+    case WAV_BIQUAD_LOWSHELF:
+        b[0] = A * ((A + 1) - (A - 1) * cw + sa), b[1] = 2 * A * ((A - 1) - (A + 1) * cw);
+        b[2] = A * ((A + 1) - (A - 1) * cw - sa);
+        a[0] = (A + 1) + (A - 1) * cw + sa, a[1] = -2 * ((A - 1) + (A + 1) * cw), a[2] = (A + 1) + (A - 1) * cw - sa;
+        break;
+    default:
+        b[0] = A * ((A + 1) + (A - 1) * cw + sa), b[1] = -2 * A * ((A - 1) + (A + 1) * cw);
+        b[2] = A * ((A + 1) + (A - 1) * cw - sa);
+        a[0] = (A + 1) - (A - 1) * cw + sa, a[1] = 2 * ((A - 1) - (A + 1) * cw), a[2] = (A + 1) - (A - 1) * cw - sa;
+        break;
+    }
+
+    // |H(e^jw)| from the numerator and denominator polynomials
+    double w = 2 * M_PI * f / RATE;
+    double nr = b[0] + b[1] * cos(w) + b[2] * cos(2 * w), ni = -b[1] * sin(w) - b[2] * sin(2 * w);
+    double dr = a[0] + a[1] * cos(w) + a[2] * cos(2 * w), di = -a[1] * sin(w) - a[2] * sin(2 * w);
+
+    return 10 * log10((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+// steady-state gain of the stage for a sine at `f`, in dB
+static double stage_gain_db(const bq_case_t *c, double f)
+{
+    static int16_t   buf[LEN];
+    wav_biquad_t     bq = WAV_BIQUAD_INIT(c->type, c->freq_hz, c->q, c->gain_db);
+    wav_dsp_format_t fmt = { .sample_rate = RATE, .bit_depth = 16, .num_channels = 1 };
+    double           in = 0, out = 0;
+
+    for (int i = 0; i < LEN; i++)
+        buf[i] = (int16_t)lrint(8000 * sin(2 * M_PI * f * i / RATE));
+    for (int i = LEN / 2; i < LEN; i++)
+        in += (double)buf[i] * buf[i];
+    wav_dsp_biquad_stage.prepare(&bq, &fmt);
+    wav_dsp_biquad_stage.process(&bq, buf, LEN);
+    for (int i = LEN / 2; i < LEN; i++)
+        out += (double)buf[i] * buf[i];
+    return 10 * log10(out / in);
+}
+
+// direct form I in double precision, the reference for the timing
+static void process_double(const double *b, const double *a, double *st, int16_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        double y = b[0] * buf[i] + b[1] * st[0] + b[2] * st[1] - a[1] * st[2] - a[2] * st[3];
+
+        st[1] = st[0], st[0] = buf[i], st[3] = st[2], st[2] = y;
+        buf[i] = (int16_t)(y > 32767 ? 32767 : y < -32768 ? -32768 : y);
+    }
+}
+
+int main(void)
+{
+    static int16_t src[SAMPLES], buf[SAMPLES];
+    int            failed = 0;
+    double         t0, copy_ns;
+
+    printf("%-24s", "response (stage - ref)");
+    for (size_t k = 0; k < sizeof(probe_hz) / sizeof(probe_hz[0]); k++)
+        printf(" %7.0f Hz", probe_hz[k]);
+    printf("\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        printf("%-24s", cases[i].name);
+        for (size_t k = 0; k < sizeof(probe_hz) / sizeof(probe_hz[0]); k++) {
+            double d = stage_gain_db(&cases[i], probe_hz[k]) - ref_gain_db(&cases[i], probe_hz[k]);
+
+            printf(" %+7.3f dB", d);
+            failed += fabs(d) > 0.1;
+        }
+        printf("\n");
+    }
+
+    printf("\n%-24s %10s\n", "coefficient range", "prepare");
+    for (size_t i = 0; i < sizeof(range_cases) / sizeof(range_cases[0]); i++) {
+        const bq_case_t *c = &range_cases[i].c;
+        wav_biquad_t     bq = WAV_BIQUAD_INIT(c->type, c->freq_hz, c->q, c->gain_db);
+        wav_dsp_format_t fmt = { .sample_rate = 44100, .bit_depth = 16, .num_channels = 1 };
+        bool             ok = wav_dsp_biquad_stage.prepare(&bq, &fmt) == ESP_OK;
+
+        printf("%-24s %10s%s\n", c->name, ok ? "accepted" : "rejected", ok == range_cases[i].fits ? "" : "  FAIL");
+        failed += ok != range_cases[i].fits;
+    }
+
+    srand(1);
+    for (int i = 0; i < SAMPLES; i++)
+        src[i] = (int16_t)(rand() % 16384 - 8192);
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        memcpy(buf, src, sizeof(buf));
+        __asm__ volatile("" : : "r"(buf) : "memory");
+    }
+    copy_ns = (now_ns() - t0) / ROUNDS;
+
+    printf("\n%-24s %10s\n", "timing", "ns/sample");
+    for (int ch = 1; ch <= 2; ch++) {
+        wav_biquad_t     bq = WAV_BIQUAD_INIT(WAV_BIQUAD_PEAKING, 1000, 1.0f, 6);
+        wav_dsp_format_t fmt = { .sample_rate = RATE, .bit_depth = 16, .num_channels = ch };
+
+        wav_dsp_biquad_stage.prepare(&bq, &fmt);
+        t0 = now_ns();
+        for (int r = 0; r < ROUNDS; r++) {
+            memcpy(buf, src, sizeof(buf));
+            wav_dsp_biquad_stage.process(&bq, buf, SAMPLES);
+            __asm__ volatile("" : : "r"(buf) : "memory");
+        }
+        printf("%-24s %10.2f\n", ch == 1 ? "Q28 stage, mono" : "Q28 stage, stereo",
+               ((now_ns() - t0) / ROUNDS - copy_ns) / SAMPLES);
+    }
+
+    double b[3] = { 1.05, -1.8, 0.8 }, a[3] = { 1, -1.8, 0.85 }, st[4] = { 0 };
+
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        memcpy(buf, src, sizeof(buf));
+        process_double(b, a, st, buf, SAMPLES);
+        __asm__ volatile("" : : "r"(buf) : "memory");
+    }
+    printf("%-24s %10.2f\n", "double reference, mono", ((now_ns() - t0) / ROUNDS - copy_ns) / SAMPLES);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*
+ * Host check and benchmark of the conversion kernels in wav_conv.c.
+ *
+ * Every kernel (u8/s16 x mono/stereo source x mono/stereo sink, with and
+ * without metering) is compared with a plain reference on random input and
+ * then timed on player-sized buffers. Times are for the host CPU and only
+ * compare the kernels with each other.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wav_conv.h"
+
+#define FRAMES 256 /* a 1 kB player buffer of s16 stereo */
+#define ROUNDS 20000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int32_t sample_in(const uint8_t *src, int i, bool u8)
+{
+    return u8 ? ((int32_t)src[i] - 128) << 8 : ((const int16_t *)src)[i];
+}
+
+// straightforward conversion of one buffer, the kernels must match it exactly
+static void conv_ref(const uint8_t *src, int16_t *dst, size_t frames, int in_ch, bool u8, int out_ch,
+                     const int32_t *g, wav_meter_acc_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < out_ch; c++) {
+            int32_t acc = 0;
+
+            if (out_ch == 1) {
+                for (int i = 0; i < in_ch; i++)
+                    acc += sample_in(src, f * in_ch + i, u8);
+            } else {
+                acc = sample_in(src, f * in_ch + (in_ch == 1 ? 0 : c), u8);
+            }
+            int32_t v = (acc * g[c]) >> CONV_SHIFT;
+            if (v > INT16_MAX || v < INT16_MIN) {
+                v = v > INT16_MAX ? INT16_MAX : INT16_MIN;
+                m->clipped++;
+            }
+            dst[f * out_ch + c] = (int16_t)v;
+
+            uint32_t a = v < 0 ? -v : v;
+            if (a > m->peak)
+                m->peak = a;
+            m->sum_sq += a * a;
+        }
+    }
+}
+
+int main(void)
+{
+    static uint8_t src[FRAMES * 4], buf[FRAMES * 4];
+    static int16_t ref[FRAMES * 2];
+    int            failed = 0;
+    double         t0, copy_ns;
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(src); i++)
+        src[i] = rand();
+
+    // the kernels run in place, so every round starts with a copy of the input
+    t0 = now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        memcpy(buf, src, sizeof(buf));
+        __asm__ volatile("" : : "r"(buf) : "memory");
+    }
+    copy_ns = (now_ns() - t0) / ROUNDS;
+
+    printf("%-6s %-8s %-6s %-5s %10s\n", "format", "source", "sink", "meter", "ns/frame");
+    for (int meter = 0; meter < 2; meter++) {
+        for (int bits = 8; bits <= 16; bits += 8) {
+            for (int in_ch = 1; in_ch <= 2; in_ch++) {
+                for (int out_ch = 1; out_ch <= 2; out_ch++) {
+                    wav_handle_t    h = { .num_channels = in_ch, .bit_depth = bits };
+                    wav_conv_fn_t   conv = wav_conv_select(&h, out_ch, meter);
+                    wav_meter_acc_t m = { 0 }, m_ref;
+                    int32_t         g[2];
+                    bool            ok;
+
+                    // 1.5x gain, so the s16 input clips now and then
+                    wav_conv_gains(&h, out_ch, CONV_UNITY * 3 / 2, g);
+                    memcpy(buf, src, sizeof(buf));
+                    conv(buf, FRAMES, g, &m);
+                    conv_ref(src, ref, FRAMES, in_ch, bits == 8, out_ch, g, &m_ref);
+                    ok = !memcmp(buf, ref, FRAMES * out_ch * sizeof(int16_t));
+                    if (meter)
+                        ok &= m.peak == m_ref.peak && m.clipped == m_ref.clipped && m.sum_sq == m_ref.sum_sq;
+
+                    t0 = now_ns();
+                    for (int r = 0; r < ROUNDS; r++) {
+                        memcpy(buf, src, sizeof(buf));
+                        conv(buf, FRAMES, g, &m);
+                        __asm__ volatile("" : : "r"(buf) : "memory");
+                    }
+                    printf("%-6s %-8s %-6s %-5s %10.2f%s\n", bits == 8 ? "u8" : "s16", in_ch == 1 ? "mono" : "stereo",
+                           out_ch == 1 ? "mono" : "stereo", meter ? "yes" : "no",
+                           ((now_ns() - t0) / ROUNDS - copy_ns) / FRAMES, ok ? "" : "  MISMATCH");
+                    failed += !ok;
+                }
+            }
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
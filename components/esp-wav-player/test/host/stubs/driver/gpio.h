@@ -0,0 +1,4 @@
+/* Minimal driver/gpio.h for host builds, see ../../Makefile */
+#pragma once
+
+typedef int gpio_num_t;
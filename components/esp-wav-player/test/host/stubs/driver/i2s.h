@@ -0,0 +1,64 @@
+/* Minimal driver/i2s.h for host builds, see ../../Makefile. There is no I2S on the host, the
+ * driver calls fail and only a custom capture source works. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2s_port_t;
+
+#define I2S_NUM_0         0
+#define I2S_NUM_1         1
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef enum { I2S_MODE_MASTER = 1, I2S_MODE_TX = 4, I2S_MODE_RX = 8 } i2s_mode_t;
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1 } i2s_comm_format_t;
+
+typedef struct {
+    int  mode;
+    int  sample_rate;
+    int  bits_per_sample;
+    int  channel_format;
+    int  communication_format;
+    int  intr_alloc_flags;
+    int  dma_buf_count;
+    int  dma_buf_len;
+    bool use_apll;
+} i2s_config_t;
+
+typedef struct {
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+static inline esp_err_t i2s_driver_install(i2s_port_t i2s, const i2s_config_t *cfg, int queue_len, void *queue)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t i2s_driver_uninstall(i2s_port_t i2s)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t i2s_set_pin(i2s_port_t i2s, const i2s_pin_config_t *pins)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t i2s_read(i2s_port_t i2s, void *dst, size_t len, size_t *got, TickType_t ticks)
+{
+    *got = 0;
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,10 @@
+/* Minimal esp_heap_caps.h for host builds, see ../Makefile */
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#define heap_caps_malloc(size, caps) malloc(size)
+#define heap_caps_free(p)            free(p)
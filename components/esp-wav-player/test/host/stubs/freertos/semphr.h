@@ -0,0 +1,11 @@
+/* FreeRTOS on pthreads for host builds, see ../../Makefile */
+#pragma once
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary()  xQueueCreate(1, 0)
+#define xSemaphoreGive(s)         xQueueSend(s, NULL, 0)
+#define xSemaphoreTake(s, ticks)  xQueueReceive(s, NULL, ticks)
+#define vSemaphoreDelete(s)       vQueueDelete(s)
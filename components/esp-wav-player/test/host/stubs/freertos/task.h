@@ -0,0 +1,12 @@
+/* FreeRTOS on pthreads for host builds, see ../../Makefile */
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *task);
+void       vTaskDelete(TaskHandle_t task);
+void       vTaskDelay(TickType_t ticks);
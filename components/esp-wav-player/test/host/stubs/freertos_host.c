@@ -0,0 +1,169 @@
+/*
+ * The FreeRTOS calls the component uses, on pthreads. Tasks are threads, a
+ * deleted task is cancelled at its next blocking call, which in the code
+ * under test is always a queue or a capture callback.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+struct host_task {
+    pthread_t      thread;
+    TaskFunction_t fn;
+    void          *arg;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    size_t          item_size;
+    size_t          len;
+    size_t          head;
+    size_t          count;
+    uint8_t         items[];
+};
+
+static void *task_main(void *arg)
+{
+    struct host_task *t = arg;
+
+    t->fn(t->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *task)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+
+    if (!t)
+        return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    if (pthread_create(&t->thread, NULL, task_main, t)) {
+        free(t);
+        return pdFAIL;
+    }
+    if (task)
+        *task = t;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task)
+        pthread_exit(NULL);
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep(ticks * 1000);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q) + len * item_size);
+
+    if (!q)
+        return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->item_size = item_size;
+    q->len = len;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+static void queue_unlock(void *arg)
+{
+    pthread_mutex_unlock(&((struct host_queue *)arg)->lock);
+}
+
+// wait for `ready` with the lock held, false on timeout
+static bool queue_wait_locked(struct host_queue *q, bool (*ready)(const struct host_queue *), TickType_t ticks)
+{
+    struct timespec until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ticks / 1000;
+    until.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    while (!ready(q)) {
+        if (!ticks)
+            return false;
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(&q->changed, &q->lock);
+        else if (pthread_cond_timedwait(&q->changed, &q->lock, &until) == ETIMEDOUT)
+            return ready(q);
+    }
+    return true;
+}
+
+// a task deleted while it waits must not leave the queue locked
+static bool queue_wait(struct host_queue *q, bool (*ready)(const struct host_queue *), TickType_t ticks)
+{
+    bool ok;
+
+    pthread_cleanup_push(queue_unlock, q);
+    ok = queue_wait_locked(q, ready, ticks);
+    pthread_cleanup_pop(0);
+    return ok;
+}
+
+static bool queue_has_room(const struct host_queue *q)
+{
+    return q->count < q->len;
+}
+
+static bool queue_has_item(const struct host_queue *q)
+{
+    return q->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!queue_wait(q, queue_has_room, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size)
+        memcpy(q->items + (q->head + q->count) % q->len * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    if (!queue_wait(q, queue_has_item, ticks)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFALSE;
+    }
+    if (q->item_size)
+        memcpy(item, q->items + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->len;
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+#
+# Host check of gen-wav-assets.py: convert synthetic tones and check the
+# output format, that resampling keeps the pitch, the loudness and peak
+# levels, the "gain" chunk and the generated header.
+#
+# Uses the Python standard library only. Run by `make run`.
+
+import math
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import wave
+
+TOOL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "gen-wav-assets.py")
+
+failed = 0
+
+
+def check(ok, what):
+    global failed
+    print("%-56s %s" % (what, "ok" if ok else "FAIL"))
+    if not ok:
+        failed += 1
+
+
+def write_tone(path, rate, width, channels, freq, peak_db, seconds, silence=0.0):
+    amp = 10.0 ** (peak_db / 20.0)
+    n = int(rate * seconds)
+    data = bytearray()
+    for i in range(n + int(rate * silence)):
+        v = amp * math.sin(2 * math.pi * freq * i / rate) if i < n else 0.0
+        for _ in range(channels):
+            if width == 1:
+                data.append(int(round(v * 127)) + 128)
+            else:
+                data += struct.pack("<h", int(round(v * 32767)))
+    with wave.open(path, "wb") as w:
+        w.setnchannels(channels)
+        w.setsampwidth(width)
+        w.setframerate(rate)
+        w.writeframes(bytes(data))
+
+
+def run_tool(src, out_dir, *opts):
+    return subprocess.run(
+        [sys.executable, TOOL, src, "-o", out_dir] + list(opts), capture_output=True, text=True, check=True
+    )
+
+
+# the chunks of a RIFF file, in order
+def chunks(path):
+    with open(path, "rb") as f:
+        raw = f.read()
+    found, pos = [], 12
+    while pos + 8 <= len(raw):
+        cid, size = raw[pos:pos + 4].decode("ascii"), struct.unpack_from("<I", raw, pos + 4)[0]
+        found.append((cid, raw[pos + 8:pos + 8 + size]))
+        pos += 8 + size + (size & 1)
+    return raw, found
+
+
+def samples(body, channels):
+    s = struct.unpack("<%dh" % (len(body) // 2), body)
+    return [s[c::channels] for c in range(channels)]
+
+
+def rms_db(x):
+    return 20 * math.log10(math.sqrt(sum(v * v for v in x) / len(x)) / 32768.0)
+
+
+def peak_db(x):
+    return 20 * math.log10(max(abs(v) for v in x) / 32768.0)
+
+
+# rising zero crossings, one per cycle
+def cycles(x):
+    return sum(1 for a, b in zip(x, x[1:]) if a < 0 <= b)
+
+
+def main():
+    with tempfile.TemporaryDirectory() as tmp:
+        src = os.path.join(tmp, "tone.wav")
+        out = os.path.join(tmp, "out")
+
+        # 1 kHz for 1 s at -6 dBFS peak (-9 dBFS RMS), then silence the loudness gate must skip;
+        # levels and cycles are measured over the tone
+        write_tone(src, 44100, 2, 1, 1000, -6.0, 1.0, silence=0.5)
+        run_tool(src, out, "--rate", "16000", "--channels", "2")
+        dst = os.path.join(out, "tone.wav")
+        raw, found = chunks(dst)
+        ids = [c[0] for c in found]
+        fmt = struct.unpack("<HHIIHH", found[0][1][:16])
+        left, right = samples(found[-1][1], 2)
+        check(ids == ["fmt ", "data"], "apply: fmt and data chunks only")
+        check(fmt == (1, 2, 16000, 64000, 4, 16), "apply: 16 kHz 16-bit stereo PCM")
+        check(abs(len(left) - 24000) <= 2, "apply: length kept across the rate change")
+        check(left == right, "apply: mono duplicated to both channels")
+        check(abs(cycles(left[:16000]) - 1000) <= 1, "apply: 1000 cycles, pitch kept")
+        check(abs(rms_db(left[:16000]) + 18.0) < 0.1, "apply: normalized to -18 dBFS gated RMS")
+
+        with open(os.path.join(out, "wav_assets.h")) as f:
+            header = f.read()
+        check("#define WAV_ASSET_TONE_LEN %d" % len(raw) in header, "apply: header length matches the file")
+        check(
+            "WAV_DECLARE_EMBED_LEN(wav_tone, _binary_tone_wav_start, WAV_ASSET_TONE_LEN);" in header,
+            "apply: header declares the clip",
+        )
+
+        # the peak ceiling wins over the loudness target
+        res = run_tool(src, out, "--rate", "16000", "--channels", "1", "--loudness", "-3")
+        left = samples(chunks(dst)[1][-1][1], 1)[0]
+        check(peak_db(left) <= -1.0 + 0.01 and "limited by peak" in res.stderr, "apply: peak held at -1 dBFS")
+
+        # gain in a chunk: the samples keep their level, the player applies the correction
+        run_tool(src, out, "--rate", "16000", "--channels", "1", "--gain-mode", "chunk")
+        _, found = chunks(dst)
+        gain = struct.unpack("<h", found[1][1][:2])[0] if len(found) == 3 else None
+        check([c[0] for c in found] == ["fmt ", "gain", "data"], "chunk: gain chunk between fmt and data")
+        check(gain is not None and abs(gain + 900) <= 5, "chunk: -9 dB correction in hundredths")
+        check(abs(rms_db(samples(found[-1][1], 1)[0][:16000]) + 9.0) < 0.1, "chunk: samples not scaled")
+
+        # gain in the header
+        run_tool(src, out, "--rate", "16000", "--channels", "1", "--gain-mode", "index")
+        with open(os.path.join(out, "wav_assets.h")) as f:
+            m = re.search(r"WAV_DECLARE_EMBED_GAIN\(wav_tone, \w+, WAV_ASSET_TONE_LEN, (\S+)f\);", f.read())
+        check(m is not None and abs(float(m.group(1)) + 9.0) < 0.05, "index: -9 dB correction in the header")
+
+        # 8-bit stereo widened and averaged to mono
+        write_tone(src, 22050, 1, 2, 440, -6.0, 1.0)
+        run_tool(src, out, "--rate", "22050", "--channels", "1", "--no-normalize")
+        _, found = chunks(dst)
+        mono = samples(found[-1][1], 1)[0]
+        check(struct.unpack("<H", found[0][1][2:4])[0] == 1, "u8 stereo: converted to mono")
+        check(abs(cycles(mono) - 440) <= 1 and abs(peak_db(mono) + 6.0) < 0.2, "u8 stereo: pitch and level kept")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
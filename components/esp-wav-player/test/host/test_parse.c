@@ -0,0 +1,247 @@
+/*
+ * Host check of the RIFF header parser.
+ *
+ * WAV files are built in memory chunk by chunk and parsed through the embed
+ * backend: the parser must find the format and the audio behind LIST, fact
+ * and odd-sized chunks, add the "gain" chunk to the descriptor gain and
+ * reject formats the player cannot convert. The example clip is parsed
+ * from disk through the file backend as well.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wav_handle.h"
+#include "wav_header.h"
+
+#define EXAMPLE_WAV "../../../../examples/esp-wav-player/wav/darude.wav"
+
+typedef struct {
+    uint8_t data[4096];
+    size_t  len;
+} riff_t;
+
+static void put(riff_t *r, const void *p, size_t n)
+{
+    memcpy(r->data + r->len, p, n);
+    r->len += n;
+}
+
+static void put_u32(riff_t *r, uint32_t v)
+{
+    put(r, &v, 4);
+}
+
+static void riff_begin(riff_t *r)
+{
+    r->len = 0;
+    put(r, "RIFF\0\0\0\0WAVE", 12);
+}
+
+// a chunk of `size` bytes, `body` or zeros, padded to an even length
+static void riff_chunk(riff_t *r, const char *id, const void *body, uint32_t size)
+{
+    put(r, id, 4);
+    put_u32(r, size);
+    if (body)
+        put(r, body, size);
+    else {
+        memset(r->data + r->len, 0, size);
+        r->len += size;
+    }
+    if (size & 1)
+        r->data[r->len++] = 0;
+}
+
+static void riff_fmt(riff_t *r, uint16_t format, uint16_t channels, uint32_t rate, uint16_t bits, uint32_t size)
+{
+    uint8_t   body[40] = { 0 };
+    wav_fmt_t fmt = {
+        .audio_format = format,
+        .num_channels = channels,
+        .sample_rate = rate,
+        .byte_rate = rate * channels * bits / 8,
+        .sample_alignment = channels * bits / 8,
+        .bit_depth = bits,
+    };
+
+    memcpy(body, &fmt, sizeof(fmt));
+    riff_chunk(r, "fmt ", body, size);
+}
+
+static void riff_gain(riff_t *r, int16_t cdb)
+{
+    wav_gain_chunk_t gain = { .gain_cdb = cdb };
+
+    riff_chunk(r, WAV_GAIN_CHUNK_ID, &gain, sizeof(gain));
+}
+
+// data chunk header and a ramp, with the RIFF size patched in
+static void riff_end(riff_t *r, uint32_t data_bytes)
+{
+    put(r, "data", 4);
+    put_u32(r, data_bytes);
+    for (uint32_t i = 0; i < data_bytes; i++)
+        r->data[r->len++] = (uint8_t)i;
+    uint32_t riff_size = r->len - 8;
+    memcpy(r->data + 4, &riff_size, 4);
+}
+
+static int failed;
+
+static void check(int ok, const char *name, const char *what)
+{
+    printf("%-36s %-28s %s\n", name, what, ok ? "ok" : "FAIL");
+    failed += !ok;
+}
+
+static wav_handle_t *parse(const riff_t *r, float gain_db, int *rc)
+{
+    wav_obj_t     obj = { .type = WAV_SRC_EMBED, .gain_db = gain_db, .embed = { r->data, r->len } };
+    wav_handle_t *h = wav_handle_init(&obj);
+
+    *rc = h && h->open(h) == 0 ? wav_parse_header(h) : -1;
+    return h;
+}
+
+// parses, and the data read from data_start is the ramp riff_end() wrote
+static void expect_ok(const riff_t *r, const char *name, size_t data_start, size_t data_bytes, float gain_db)
+{
+    int           rc;
+    wav_handle_t *h = parse(r, 2.0f, &rc);
+    uint8_t       first[4] = { 0xff, 0xff, 0xff, 0xff };
+
+    check(rc == 0, name, "parsed");
+    if (rc == 0) {
+        check(h->data_start == data_start, name, "data_start");
+        check(h->data_bytes == data_bytes, name, "data_bytes");
+        check(h->gain_db == gain_db, name, "gain_db");
+        h->seek(h, h->data_start);
+        h->read(h, first, sizeof(first));
+        check(first[0] == 0 && first[1] == 1 && first[2] == 2 && first[3] == 3, name, "audio at data_start");
+    }
+    if (h)
+        wav_handle_free(h);
+}
+
+static void expect_reject(const riff_t *r, const char *name)
+{
+    int           rc;
+    wav_handle_t *h = parse(r, 0, &rc);
+
+    check(rc != 0, name, "rejected");
+    if (h)
+        wav_handle_free(h);
+}
+
+static void check_example(void)
+{
+    wav_obj_t     obj = { .type = WAV_SRC_SPIFFS, .spiffs = { EXAMPLE_WAV } };
+    wav_handle_t *h = wav_handle_init(&obj);
+    FILE         *f = fopen(EXAMPLE_WAV, "rb");
+    char          id[4] = { 0 };
+    long          size = 0;
+
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fclose(f);
+    }
+    check(h && h->open(h) == 0 && wav_parse_header(h) == 0, "example darude.wav", "parsed");
+    if (h && size) {
+        h->seek(h, h->data_start - 8);
+        h->read(h, id, sizeof(id));
+        check(!memcmp(id, "data", 4), "example darude.wav", "data_start");
+        check(h->data_start + h->data_bytes <= (size_t)size, "example darude.wav", "data_bytes");
+        h->close(h);
+    }
+    if (h)
+        wav_handle_free(h);
+}
+
+int main(void)
+{
+    riff_t r;
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 16, 16);
+    riff_end(&r, 1000);
+    expect_ok(&r, "canonical", 44, 1000, 2.0f);
+
+    riff_begin(&r);
+    riff_chunk(&r, "LIST", "INFOx", 5);
+    riff_fmt(&r, 1, 1, 16000, 16, 16);
+    riff_chunk(&r, "fact", NULL, 4);
+    riff_end(&r, 1000);
+    expect_ok(&r, "LIST (odd size) and fact", 12 + 14 + 24 + 12 + 8, 1000, 2.0f);
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 44100, 16, 18);
+    riff_gain(&r, -350);
+    riff_end(&r, 1000);
+    expect_ok(&r, "18 byte fmt, gain chunk", 12 + 26 + 12 + 8, 1000, -1.5f);
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 8000, 16, 16);
+    riff_end(&r, 1001);
+    expect_ok(&r, "partial last frame", 44, 1000, 2.0f);
+
+    riff_begin(&r);
+    for (int i = 0; i < WAV_MAX_CHUNKS - 2; i++)
+        riff_chunk(&r, "junk", NULL, 2);
+    riff_fmt(&r, 1, 1, 8000, 8, 16);
+    riff_end(&r, 100);
+    expect_ok(&r, "data as the last chunk looked at", 12 + (WAV_MAX_CHUNKS - 2) * 10 + 24 + 8, 100, 2.0f);
+
+    riff_begin(&r);
+    for (int i = 0; i < WAV_MAX_CHUNKS - 1; i++)
+        riff_chunk(&r, "junk", NULL, 2);
+    riff_fmt(&r, 1, 1, 8000, 8, 16);
+    riff_end(&r, 100);
+    expect_reject(&r, "data beyond WAV_MAX_CHUNKS");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 3, 22050, 16, 16);
+    riff_end(&r, 600);
+    expect_reject(&r, "3 channels");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 24, 16);
+    riff_end(&r, 600);
+    expect_reject(&r, "24-bit");
+
+    riff_begin(&r);
+    riff_fmt(&r, 3, 1, 22050, 16, 16);
+    riff_end(&r, 600);
+    expect_reject(&r, "IEEE float");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 16, 16);
+    r.data[12 + 8 + 12] = 3; // block align
+    riff_end(&r, 600);
+    expect_reject(&r, "inconsistent block align");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 16, 8);
+    riff_end(&r, 600);
+    expect_reject(&r, "short fmt chunk");
+
+    riff_begin(&r);
+    put(&r, "data", 4);
+    put_u32(&r, 0);
+    riff_fmt(&r, 1, 2, 22050, 16, 16);
+    expect_reject(&r, "data before fmt");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 16, 16);
+    put(&r, "LIST", 4);
+    put_u32(&r, 1 << 20);
+    expect_reject(&r, "truncated chunk");
+
+    riff_begin(&r);
+    riff_fmt(&r, 1, 2, 22050, 16, 16);
+    expect_reject(&r, "no data chunk");
+
+    check_example();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/*
+ * Host check of the recorder's capture path.
+ *
+ * A synthetic source stands in for I2S and delivers a ramp: frame n holds n
+ * in the left channel and -n in the right one. The source holds back at a
+ * given frame until the recording is started, so the frames captured before
+ * the start are known exactly. The file must then hold an unbroken ramp
+ * that begins with the last `pretrigger_ms` of audio before the start, and
+ * its header must carry the sizes of what was written.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_wav_recorder.h"
+#include "wav_header.h"
+
+#define RATE 16000
+
+typedef struct {
+    const char *name;
+    int         bits;
+    int         channels;
+    uint32_t    pretrigger_ms;
+    uint32_t    start_at; /* frame at which the source waits for the start */
+    uint32_t    tail;     /* frames recorded after the start, at least */
+} rec_case_t;
+
+static const rec_case_t cases[] = {
+    { "16-bit mono, ring filling", 16, 1, 100, 1000, 20000 },
+    { "16-bit mono, ring wrapped", 16, 1, 100, 4000, 20000 },
+    { "32-bit stereo, ring wrapped", 32, 2, 50, 3000, 10000 },
+    { "16-bit mono, no pre-trigger", 16, 1, 0, 1000, 5000 },
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    uint32_t        produced;
+    uint32_t        gate; /* UINT32_MAX once released */
+    bool            waiting;
+    uint32_t        trigger_end; /* frames produced by the call the start interrupted */
+} src = { .lock = PTHREAD_MUTEX_INITIALIZER, .changed = PTHREAD_COND_INITIALIZER };
+
+static void put_frame(uint8_t *p, const rec_case_t *c, uint32_t n)
+{
+    for (int ch = 0; ch < c->channels; ch++) {
+        int32_t v = ch ? -(int32_t)n : (int32_t)n;
+
+        if (c->bits == 16)
+            ((int16_t *)p)[ch] = (int16_t)v;
+        else
+            ((int32_t *)p)[ch] = v;
+    }
+}
+
+static size_t ramp_capture(void *buf, size_t len, void *arg)
+{
+    const rec_case_t *c = arg;
+    size_t            align = c->channels * c->bits / 8;
+    bool              released = false;
+
+    pthread_mutex_lock(&src.lock);
+    if (src.produced >= src.gate) {
+        src.waiting = true;
+        pthread_cond_broadcast(&src.changed);
+        while (src.gate != UINT32_MAX)
+            pthread_cond_wait(&src.changed, &src.lock);
+        released = true;
+    }
+    uint32_t n = src.produced;
+    pthread_mutex_unlock(&src.lock);
+
+    for (size_t i = 0; i < len / align; i++)
+        put_frame((uint8_t *)buf + i * align, c, n + i);
+
+    pthread_mutex_lock(&src.lock);
+    src.produced += len / align;
+    if (released)
+        src.trigger_end = src.produced;
+    pthread_cond_broadcast(&src.changed);
+    pthread_mutex_unlock(&src.lock);
+
+    usleep(200); // a DMA buffer does not fill at once
+    return len;
+}
+
+static int fail(const char *name, const char *what)
+{
+    printf("%-30s FAIL: %s\n", name, what);
+    return 1;
+}
+
+static int run(const rec_case_t *c)
+{
+    esp_wav_recorder_config_t cfg = {
+        .base_cfg = {
+            .mode = I2S_MODE_MASTER | I2S_MODE_RX,
+            .sample_rate = RATE,
+            .bits_per_sample = c->bits,
+            .channel_format = c->channels == 1 ? I2S_CHANNEL_FMT_ONLY_LEFT : I2S_CHANNEL_FMT_RIGHT_LEFT,
+            .dma_buf_count = 4,
+            .dma_buf_len = 256,
+        },
+        .capture = ramp_capture,
+        .capture_arg = (void *)c,
+        .pretrigger_ms = c->pretrigger_ms,
+    };
+    esp_wav_recorder_t       rec;
+    esp_wav_recorder_stats_t stats;
+    wav_header_t             hdr;
+    char                     path[] = "/tmp/wavrecXXXXXX";
+    size_t                   align = c->channels * c->bits / 8;
+    uint32_t                 ring = c->pretrigger_ms * RATE / 1000;
+    int                      fd = mkstemp(path);
+
+    if (fd < 0)
+        return fail(c->name, "no temporary file");
+    close(fd);
+
+    src.produced = 0;
+    src.gate = c->start_at;
+    src.waiting = false;
+    src.trigger_end = 0;
+
+    if (esp_wav_recorder_init(&rec, &cfg) != ESP_OK)
+        return fail(c->name, "init");
+
+    pthread_mutex_lock(&src.lock);
+    while (!src.waiting)
+        pthread_cond_wait(&src.changed, &src.lock);
+    pthread_mutex_unlock(&src.lock);
+
+    esp_err_t start_err = esp_wav_recorder_start(rec, path);
+
+    pthread_mutex_lock(&src.lock);
+    src.gate = UINT32_MAX;
+    pthread_cond_broadcast(&src.changed);
+    while (src.trigger_end == 0 || src.produced < src.trigger_end + c->tail)
+        pthread_cond_wait(&src.changed, &src.lock);
+    pthread_mutex_unlock(&src.lock);
+
+    esp_err_t stop_err = start_err == ESP_OK ? esp_wav_recorder_stop(rec) : start_err;
+    esp_wav_recorder_get_stats(rec, &stats);
+    esp_wav_recorder_deinit(rec);
+    if (stop_err != ESP_OK)
+        return fail(c->name, "start or stop");
+
+    FILE *f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(size);
+    size_t   got = fread(data, 1, size, f);
+    fclose(f);
+    remove(path);
+    if (got != (size_t)size || got < sizeof(hdr)) {
+        free(data);
+        return fail(c->name, "file unreadable");
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+
+    // the pre-trigger ring holds the last `ring` frames before the start, fewer if it was not full yet
+    uint32_t first = src.trigger_end - (src.trigger_end < ring ? src.trigger_end : ring);
+    uint32_t frames = hdr.data_bytes / align;
+    uint8_t  want[8];
+    int      failed = 0;
+
+    if (memcmp(hdr.riff_header, "RIFF", 4) || memcmp(hdr.wave_header, "WAVE", 4) ||
+        memcmp(hdr.data_header, "data", 4) || hdr.num_channels != c->channels || hdr.bit_depth != c->bits ||
+        hdr.sample_rate != RATE || hdr.sample_alignment != align)
+        failed += fail(c->name, "header fields");
+    if (hdr.data_bytes != size - sizeof(hdr) || hdr.data_bytes != stats.data_bytes || hdr.data_bytes % align)
+        failed += fail(c->name, "data size does not match the file");
+    if (hdr.wav_size != size - 8)
+        failed += fail(c->name, "RIFF size does not match the file");
+    if (stats.overruns)
+        failed += fail(c->name, "overruns");
+    if (frames < src.trigger_end - first + c->tail)
+        failed += fail(c->name, "recording too short");
+    for (uint32_t i = 0; i < frames && !failed; i++) {
+        put_frame(want, c, first + i);
+        if (memcmp(data + sizeof(hdr) + i * align, want, align)) {
+            char what[64];
+            snprintf(what, sizeof(what), "ramp broken at frame %u of %u", (unsigned)i, (unsigned)frames);
+            failed += fail(c->name, what);
+        }
+    }
+    free(data);
+
+    if (!failed)
+        printf("%-30s ok: %u frames, %u from before the start (ring %u)\n", c->name, (unsigned)frames,
+               (unsigned)(src.trigger_end - first), (unsigned)ring);
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        failed += run(&cases[i]);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
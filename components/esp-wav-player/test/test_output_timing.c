@@ -0,0 +1,162 @@
+/*
+ * On-target output timing, measured on the wire instead of trusting the
+ * player's own clock. Build with the unit test app (`-T esp-wav-player`).
+ *
+ * Wiring: connect the I2S data output (GPIO33 in ESP_WAV_PLAYER_DEFAULT_CONFIG)
+ * to TEST_PROBE_GPIO. The test clip starts with a sample that has its top bit
+ * set after silence, so the first rising edge on the probe is the first bit of
+ * the clip; a GPIO interrupt timestamps it with esp_timer. GPIO interrupt
+ * latency (a few us) is included in every figure.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_wav_player.h"
+
+#ifndef TEST_PROBE_GPIO
+#define TEST_PROBE_GPIO GPIO_NUM_26
+#endif
+
+#define TEST_RUNS          20
+#define TEST_CLIP_FRAMES   1024  /* 46 ms at 22050 Hz */
+#define TEST_MAX_JITTER_US 1000  /* spread of the start error over all runs */
+#define TEST_IDLE_STOP_MS  100
+#define TEST_MAX_WAKE_US   50000 /* play() on an idle player to the first sample on the wire */
+
+static uint8_t          clip_data[44 + TEST_CLIP_FRAMES * 4];
+static volatile int64_t edge_us;
+
+WAV_DECLARE_EMBED_LEN(test_clip, clip_data, sizeof(clip_data));
+
+static void put_le(uint8_t *p, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = v >> (8 * i);
+}
+
+// 16-bit stereo at 22050 Hz, every sample -32768: the first bit on the wire is a 1
+static void clip_init(void)
+{
+    uint8_t *h = clip_data;
+
+    memcpy(h, "RIFF", 4);
+    put_le(h + 4, sizeof(clip_data) - 8, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put_le(h + 16, 16, 4);
+    put_le(h + 20, 1, 2);         // PCM
+    put_le(h + 22, 2, 2);         // channels
+    put_le(h + 24, 22050, 4);     // sample rate
+    put_le(h + 28, 22050 * 4, 4); // byte rate
+    put_le(h + 32, 4, 2);         // block align
+    put_le(h + 34, 16, 2);        // bits per sample
+    memcpy(h + 36, "data", 4);
+    put_le(h + 40, TEST_CLIP_FRAMES * 4, 4);
+    for (size_t i = 44; i < sizeof(clip_data); i += 2)
+        put_le(clip_data + i, 0x8000, 2);
+}
+
+static void IRAM_ATTR probe_isr(void *arg)
+{
+    if (!edge_us)
+        edge_us = esp_timer_get_time();
+}
+
+static esp_wav_player_t timing_setup(uint32_t idle_stop_ms)
+{
+    esp_wav_player_config_t cfg = ESP_WAV_PLAYER_DEFAULT_CONFIG();
+    esp_wav_player_t        player;
+    gpio_config_t           probe = {
+        .pin_bit_mask = 1ULL << TEST_PROBE_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+
+    clip_init();
+    cfg.idle_stop_ms = idle_stop_ms;
+    TEST_ESP_OK(esp_wav_player_init(&player, &cfg));
+    TEST_ESP_OK(gpio_config(&probe));
+    TEST_ESP_OK(gpio_install_isr_service(0));
+    TEST_ESP_OK(gpio_isr_handler_add(TEST_PROBE_GPIO, probe_isr, NULL));
+    return player;
+}
+
+static void timing_teardown(esp_wav_player_t player)
+{
+    gpio_isr_handler_remove(TEST_PROBE_GPIO);
+    gpio_uninstall_isr_service();
+    TEST_ESP_OK(esp_wav_player_deinit(player));
+}
+
+// print the statistics of `runs` errors, returns their spread
+static int64_t report(const char *what, const int64_t *err, int runs)
+{
+    int64_t min = INT64_MAX, max = INT64_MIN, sum = 0;
+
+    for (int i = 0; i < runs; i++) {
+        min = err[i] < min ? err[i] : min;
+        max = err[i] > max ? err[i] : max;
+        sum += err[i];
+    }
+    printf("%s over %d runs: min %" PRId64 " us, max %" PRId64 " us, mean %" PRId64 " us, spread %" PRId64 " us\n",
+           what, runs, min, max, sum / runs, max - min);
+    return max - min;
+}
+
+TEST_CASE("play_at start error on the wire", "[esp_wav_player][timing]")
+{
+    esp_wav_player_t player = timing_setup(0);
+    int64_t          err[TEST_RUNS];
+    int64_t          spread;
+
+    for (int i = 0; i < TEST_RUNS; i++) {
+        int64_t target = esp_timer_get_time() + 200000;
+
+        edge_us = 0;
+        TEST_ESP_OK(esp_wav_player_play_at(player, &test_clip, target));
+        vTaskDelay(pdMS_TO_TICKS(400));
+        TEST_ASSERT_TRUE_MESSAGE(edge_us != 0, "no edge on the probe, check the wiring");
+        err[i] = edge_us - target;
+    }
+    spread = report("play_at start error", err, TEST_RUNS);
+    timing_teardown(player);
+    TEST_ASSERT_LESS_THAN(TEST_MAX_JITTER_US, (int)spread);
+}
+
+TEST_CASE("wake-up to first sample on the wire", "[esp_wav_player][timing]")
+{
+    esp_wav_player_t       player = timing_setup(TEST_IDLE_STOP_MS);
+    esp_wav_player_power_t pwr;
+    int64_t                wire[TEST_RUNS], dma[TEST_RUNS];
+    int64_t                worst = 0;
+
+    for (int i = 0; i < TEST_RUNS; i++) {
+        int64_t t0;
+
+        // let the clocks stop
+        for (int wait = 0; wait < 100; wait++) {
+            TEST_ESP_OK(esp_wav_player_get_power(player, &pwr));
+            if (pwr.idle)
+                break;
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        TEST_ASSERT_TRUE_MESSAGE(pwr.idle, "player did not go idle");
+
+        edge_us = 0;
+        t0 = esp_timer_get_time();
+        TEST_ESP_OK(esp_wav_player_play(player, &test_clip));
+        vTaskDelay(pdMS_TO_TICKS(300));
+        TEST_ASSERT_TRUE_MESSAGE(edge_us != 0, "no edge on the probe, check the wiring");
+        TEST_ESP_OK(esp_wav_player_get_power(player, &pwr));
+        wire[i] = edge_us - t0;
+        dma[i] = pwr.wake_us;
+        worst = wire[i] > worst ? wire[i] : worst;
+    }
+    // the player's figure stops at the DMA, the wire adds the silence still queued in front of the clip
+    report("wake-up to first sample handed to the DMA", dma, TEST_RUNS);
+    report("wake-up to first sample on the wire", wire, TEST_RUNS);
+    timing_teardown(player);
+    TEST_ASSERT_LESS_THAN(TEST_MAX_WAKE_US, (int)worst);
+}
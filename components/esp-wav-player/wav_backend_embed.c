@@ -10,6 +10,7 @@
 
 typedef struct {
     const uint8_t *data; // pointer to WAV in flash
+    size_t         len;  // size of the data, 0 if unknown
     size_t         pos;  // current read offset
 } wav_embed_ctx_t;
 
@@ -32,17 +33,39 @@ static size_t embed_read(wav_handle_t *h, void *buf, size_t len)
     if (!c || !c->data)
         return 0;
 
+    if (c->len && len > c->len - c->pos)
+        len = c->len - c->pos;
+
     memcpy(buf, c->data + c->pos, len);
     c->pos += len;
 
     return len;
 }
 
+// no copy at all, the player writes straight from flash
+static const void *embed_map(wav_handle_t *h, size_t *len)
+{
+    wav_embed_ctx_t *c = h->ctx;
+    const uint8_t   *p;
+
+    if (!c || !c->data) {
+        *len = 0;
+        return NULL;
+    }
+
+    if (c->len && *len > c->len - c->pos)
+        *len = c->len - c->pos;
+
+    p = c->data + c->pos;
+    c->pos += *len;
+    return p;
+}
+
 static int embed_seek(wav_handle_t *h, size_t offset)
 {
     wav_embed_ctx_t *c = h->ctx;
 
-    if (!c || !c->data)
+    if (!c || !c->data || (c->len && offset > c->len))
         return -1;
 
     c->pos = offset;
@@ -63,7 +86,7 @@ static void embed_cleanup(wav_handle_t *h)
     h->ctx = NULL;
 }
 
-wav_handle_t *wav_backend_embed_create(const uint8_t *data)
+wav_handle_t *wav_backend_embed_create(const uint8_t *data, size_t len)
 {
     if (!data)
         return NULL;
@@ -78,12 +101,14 @@ wav_handle_t *wav_backend_embed_create(const uint8_t *data)
     }
 
     ctx->data = data;
+    ctx->len = len;
     ctx->pos = 0;
 
     h->ctx = ctx;
     h->open = embed_open;
     h->read = embed_read;
     h->seek = embed_seek;
+    h->map = embed_map;
     h->close = embed_close;
     h->clean_ctx = embed_cleanup;
     return h;
@@ -0,0 +1,265 @@
+#include "wav_handle.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <esp_log.h>
+
+/*
+   Tones are generated on the fly as 16-bit mono with a fixed-point DDS:
+   a 32-bit phase accumulator indexes a 256 entry sine table, interpolated
+   linearly, and each tone gets a linear attack/release envelope.
+*/
+
+#define TONE_SAMPLE_RATE 22050
+#define TONE_LUT_BITS    8
+
+static const char *TAG = "WAVTONE";
+
+// one period of sine in Q15, with a guard entry for the interpolation
+static const int16_t sine_lut[(1 << TONE_LUT_BITS) + 1] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+    32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571,
+    30273, 29956, 29621, 29268, 28898, 28510, 28105, 27683,
+    27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+    23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868,
+    18204, 17530, 16846, 16151, 15446, 14732, 14010, 13279,
+    12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+    6393, 5602, 4808, 4011, 3212, 2410, 1608, 804,
+    0, -804, -1608, -2410, -3212, -4011, -4808, -5602,
+    -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+    -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+    -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+    -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+    -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+    -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+    -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+    -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+    -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179,
+    -6393, -5602, -4808, -4011, -3212, -2410, -1608, -804,
+    0,
+};
+
+typedef struct {
+    wav_tone_type_t type;
+    const char     *digits;
+    uint32_t        segments; /* tones in the sequence, DTMF digits */
+    uint32_t        inc[2];   /* DDS phase increments, inc[1] is 0 for single tones */
+    int64_t         sweep_step;
+    int32_t         amp; /* Q15 amplitude of each oscillator */
+    uint32_t        on;  /* samples per tone */
+    uint32_t        gap; /* silent samples after each tone */
+    uint32_t        attack;
+    uint32_t        release;
+
+    /* generator state */
+    uint32_t seg;
+    uint32_t pos; /* sample within the current tone + gap */
+    uint32_t phase[2];
+    int64_t  sweep_inc; /* Q16 extended phase increment of a sweep */
+} wav_tone_ctx_t;
+
+static uint32_t tone_inc(uint32_t freq_hz)
+{
+    return ((uint64_t)freq_hz << 32) / TONE_SAMPLE_RATE;
+}
+
+static inline int32_t dds_sine(uint32_t phase)
+{
+    uint32_t idx = phase >> (32 - TONE_LUT_BITS);
+    int32_t  frac = (phase >> (16 - TONE_LUT_BITS)) & 0xffff;
+    int32_t  a = sine_lut[idx];
+
+    return a + (((sine_lut[idx + 1] - a) * frac) >> 16);
+}
+
+// unknown characters (e.g. ',') give a silent digit, usable as a pause
+static void dtmf_incs(char digit, uint32_t inc[2])
+{
+    static const char     keys[] = "123A456B789C*0#D";
+    static const uint16_t rows[] = { 697, 770, 852, 941 };
+    static const uint16_t cols[] = { 1209, 1336, 1477, 1633 };
+    const char           *k = digit ? strchr(keys, toupper((unsigned char)digit)) : NULL;
+
+    if (!k) {
+        inc[0] = inc[1] = 0;
+        return;
+    }
+    inc[0] = tone_inc(rows[(k - keys) / 4]);
+    inc[1] = tone_inc(cols[(k - keys) % 4]);
+}
+
+// position the generator at `sample` from the start of the sequence
+static void tone_locate(wav_tone_ctx_t *c, uint32_t sample)
+{
+    uint32_t seg_len = c->on + c->gap;
+
+    c->seg = sample / seg_len;
+    c->pos = sample % seg_len;
+    c->phase[0] = 0;
+    c->phase[1] = 0;
+    if (c->type == WAV_TONE_DTMF && c->seg < c->segments)
+        dtmf_incs(c->digits[c->seg], c->inc);
+    if (c->type == WAV_TONE_SWEEP)
+        c->sweep_inc = ((int64_t)c->inc[0] << 16) + c->sweep_step * c->pos;
+}
+
+static int32_t tone_envelope(const wav_tone_ctx_t *c)
+{
+    if (c->pos < c->attack)
+        return (c->pos << 15) / c->attack;
+    if (c->pos + c->release > c->on)
+        return ((c->on - c->pos) << 15) / c->release;
+    return 1 << 15;
+}
+
+static int tone_open(wav_handle_t *h)
+{
+    wav_tone_ctx_t *c = h->ctx;
+
+    if (!c)
+        return -1;
+
+    tone_locate(c, 0);
+    return 0;
+}
+
+static size_t tone_read(wav_handle_t *h, void *buf, size_t len)
+{
+    wav_tone_ctx_t *c = h->ctx;
+    int16_t        *out = buf;
+    size_t          n = len / sizeof(int16_t);
+    size_t          i;
+
+    for (i = 0; i < n && c->seg < c->segments; i++) {
+        int32_t s = 0;
+
+        if (c->pos < c->on) {
+            s = dds_sine(c->phase[0]);
+            if (c->inc[1])
+                s += dds_sine(c->phase[1]);
+            s = (((s * c->amp) >> 15) * tone_envelope(c)) >> 15;
+
+            if (c->type == WAV_TONE_SWEEP) {
+                c->phase[0] += (uint32_t)(c->sweep_inc >> 16);
+                c->sweep_inc += c->sweep_step;
+            } else {
+                c->phase[0] += c->inc[0];
+                c->phase[1] += c->inc[1];
+            }
+        }
+        out[i] = (int16_t)s;
+
+        if (++c->pos == c->on + c->gap)
+            tone_locate(c, (c->seg + 1) * (c->on + c->gap));
+    }
+    return i * sizeof(int16_t);
+}
+
+static int tone_seek(wav_handle_t *h, size_t offset)
+{
+    wav_tone_ctx_t *c = h->ctx;
+
+    if (!c)
+        return -1;
+
+    tone_locate(c, offset / sizeof(int16_t));
+    return 0;
+}
+
+static int tone_parse(wav_handle_t *h)
+{
+    wav_tone_ctx_t *c = h->ctx;
+
+    h->num_channels = 1;
+    h->sample_rate = TONE_SAMPLE_RATE;
+    h->bit_depth = 16;
+    h->sample_alignment = sizeof(int16_t);
+    h->byte_rate = TONE_SAMPLE_RATE * sizeof(int16_t);
+    h->data_start = 0;
+    h->data_bytes = (size_t)c->segments * (c->on + c->gap) * sizeof(int16_t);
+    return h->seek(h, h->data_start);
+}
+
+static void tone_close(wav_handle_t *h)
+{
+    // nothing to do for generated data
+}
+
+static void tone_cleanup(wav_handle_t *h)
+{
+    if (!h)
+        return;
+
+    free(h->ctx);
+    h->ctx = NULL;
+}
+
+// 22.05 samples per ms: scale before dividing so long tones keep their length
+static uint32_t tone_samples(uint32_t ms)
+{
+    return (uint64_t)ms * TONE_SAMPLE_RATE / 1000;
+}
+
+wav_handle_t *wav_backend_tone_create(const wav_obj_t *src)
+{
+    if (!src->tone.duration_ms || src->tone.level > 100 || src->tone.freq_hz >= TONE_SAMPLE_RATE / 2 ||
+        src->tone.freq_end_hz >= TONE_SAMPLE_RATE / 2 || (src->tone.type == WAV_TONE_DTMF && !src->tone.digits)) {
+        ESP_LOGE(TAG, "bad tone parameters");
+        return NULL;
+    }
+
+    wav_handle_t   *h = calloc(1, sizeof(*h));
+    wav_tone_ctx_t *ctx = calloc(1, sizeof(*ctx));
+
+    if (!h || !ctx) {
+        free(h);
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->type = src->tone.type;
+    ctx->digits = src->tone.digits;
+    ctx->segments = ctx->type == WAV_TONE_DTMF ? strlen(ctx->digits) : 1;
+    ctx->amp = (int32_t)src->tone.level * INT16_MAX / 100;
+    ctx->on = tone_samples(src->tone.duration_ms);
+    ctx->gap = tone_samples(src->tone.gap_ms);
+    ctx->attack = tone_samples(src->tone.attack_ms);
+    ctx->release = tone_samples(src->tone.release_ms);
+    if (ctx->attack + ctx->release > ctx->on)
+        ctx->attack = ctx->release = ctx->on / 2;
+
+    switch (ctx->type) {
+    case WAV_TONE_SWEEP:
+        ctx->inc[0] = tone_inc(src->tone.freq_hz);
+        ctx->sweep_step = (((int64_t)tone_inc(src->tone.freq_end_hz) - ctx->inc[0]) << 16) / ctx->on;
+        break;
+    case WAV_TONE_DTMF:
+        ctx->amp /= 2; // two oscillators
+        break;
+    default:
+        ctx->inc[0] = tone_inc(src->tone.freq_hz);
+        break;
+    }
+
+    h->ctx = ctx;
+    h->open = tone_open;
+    h->read = tone_read;
+    h->seek = tone_seek;
+    h->close = tone_close;
+    h->clean_ctx = tone_cleanup;
+    h->parse = tone_parse;
+    return h;
+}
@@ -0,0 +1,108 @@
+#include "wav_conv.h"
+
+/*
+ * Conversion kernels: normalize a buffer in place from the track format to
+ * the sink layout (16-bit, sink channel count) in one pass, fused with the
+ * volume gain and optionally with peak/sum-of-squares metering.
+ *
+ * - u8 is widened to s16
+ * - mono is duplicated to both channels of a stereo sink
+ * - stereo is averaged for a mono sink
+ *
+ * Gains are Q12 with the 1/n of the averaging folded in, see wav_conv_gains().
+ * Expanding layouts run back to front, so the output never overwrites input
+ * that is still to be read. Each combination is instantiated with constant
+ * channel counts, which fully unrolls the per-frame channel loops.
+ */
+static inline __attribute__((always_inline)) void conv_body(uint8_t *buf, size_t frames, const int in_ch,
+                                                            const bool u8, const int out_ch, const int32_t *g,
+                                                            wav_meter_acc_t *m, const bool meter)
+{
+    const size_t in_b = in_ch * (u8 ? 1 : 2);
+    const size_t out_b = out_ch * 2;
+    const bool   backward = out_b > in_b;
+    const int32_t g0 = g[0], g1 = g[1];
+    uint32_t     peak = 0, clipped = 0;
+    uint64_t     sum_sq = 0;
+
+#pragma GCC unroll 4
+    for (size_t k = 0; k < frames; k++) {
+        size_t         i = backward ? frames - 1 - k : k;
+        const uint8_t *src = buf + i * in_b;
+        int16_t       *dst = (int16_t *)(buf + i * out_b);
+        int32_t        acc[2] = { 0, 0 };
+
+        for (int c = 0; c < in_ch; c++) {
+            int32_t x = u8 ? ((int32_t)src[c] - 128) << 8 : ((const int16_t *)src)[c];
+            acc[out_ch == 1 ? 0 : c] += x;
+        }
+        if (in_ch == 1 && out_ch == 2)
+            acc[1] = acc[0];
+
+        for (int c = 0; c < out_ch; c++) {
+            int32_t v = (acc[c] * (c ? g1 : g0)) >> CONV_SHIFT;
+            if (v > INT16_MAX) {
+                v = INT16_MAX;
+                clipped++;
+            } else if (v < INT16_MIN) {
+                v = INT16_MIN;
+                clipped++;
+            }
+            dst[c] = (int16_t)v;
+            if (meter) {
+                uint32_t a = v < 0 ? -v : v;
+                if (a > peak)
+                    peak = a;
+                sum_sq += a * a;
+            }
+        }
+    }
+    if (meter) {
+        m->peak = peak;
+        m->clipped = clipped;
+        m->sum_sq = sum_sq;
+    }
+}
+
+#define CONV_FNS(fmt, u8, in_ch, out_ch)                                                                        \
+    static void conv_##fmt##_##in_ch##_##out_ch(uint8_t *buf, size_t frames, const int32_t *g,                  \
+                                                wav_meter_acc_t *m)                                             \
+    {                                                                                                           \
+        conv_body(buf, frames, in_ch, u8, out_ch, g, m, false);                                                 \
+    }                                                                                                           \
+    static void conv_##fmt##_##in_ch##_##out_ch##_m(uint8_t *buf, size_t frames, const int32_t *g,              \
+                                                    wav_meter_acc_t *m)                                         \
+    {                                                                                                           \
+        conv_body(buf, frames, in_ch, u8, out_ch, g, m, true);                                                  \
+    }
+
+CONV_FNS(u8, true, 1, 1)
+CONV_FNS(u8, true, 1, 2)
+CONV_FNS(u8, true, 2, 1)
+CONV_FNS(u8, true, 2, 2)
+CONV_FNS(s16, false, 1, 1)
+CONV_FNS(s16, false, 1, 2)
+CONV_FNS(s16, false, 2, 1)
+CONV_FNS(s16, false, 2, 2)
+
+// [metering][s16][mono, stereo source][mono, stereo sink]
+static const wav_conv_fn_t conv_table[2][2][2][2] = {
+    {
+        { { conv_u8_1_1, conv_u8_1_2 }, { conv_u8_2_1, conv_u8_2_2 } },
+        { { conv_s16_1_1, conv_s16_1_2 }, { conv_s16_2_1, conv_s16_2_2 } },
+    },
+    {
+        { { conv_u8_1_1_m, conv_u8_1_2_m }, { conv_u8_2_1_m, conv_u8_2_2_m } },
+        { { conv_s16_1_1_m, conv_s16_1_2_m }, { conv_s16_2_1_m, conv_s16_2_2_m } },
+    },
+};
+
+wav_conv_fn_t wav_conv_select(const wav_handle_t *h, int out_ch, bool meter)
+{
+    return conv_table[meter][h->bit_depth == 16][h->num_channels - 1][out_ch - 1];
+}
+
+void wav_conv_gains(const wav_handle_t *h, int out_ch, int32_t gain, int32_t g[2])
+{
+    g[0] = g[1] = out_ch == 1 ? gain / h->num_channels : gain;
+}
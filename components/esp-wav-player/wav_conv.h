@@ -0,0 +1,29 @@
+#ifndef ESP_WAV_PLAYER_WAV_CONV_H_
+#define ESP_WAV_PLAYER_WAV_CONV_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wav_handle.h"
+
+// conversion gains are Q12
+#define CONV_SHIFT 12
+#define CONV_UNITY (1 << CONV_SHIFT)
+
+typedef struct {
+    uint32_t peak;
+    uint32_t clipped;
+    uint64_t sum_sq;
+} wav_meter_acc_t;
+
+/* converts `frames` in place to the sink layout, `m` is filled by metering kernels */
+typedef void (*wav_conv_fn_t)(uint8_t *buf, size_t frames, const int32_t *g, wav_meter_acc_t *m);
+
+// kernel converting frames of `h` to 16-bit frames with `out_ch` (1 or 2) channels
+wav_conv_fn_t wav_conv_select(const wav_handle_t *h, int out_ch, bool meter);
+
+// Q12 `gain` to the per-sink-channel gains of the kernel, with the 1/n of a downmix folded in
+void wav_conv_gains(const wav_handle_t *h, int out_ch, int32_t gain, int32_t g[2]);
+
+#endif /* ESP_WAV_PLAYER_WAV_CONV_H_ */
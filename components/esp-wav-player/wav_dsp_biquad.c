@@ -0,0 +1,148 @@
+#include "include/wav_dsp.h"
+#include <math.h>
+#include <string.h>
+#include <esp_log.h>
+
+#define BIQUAD_Q   28
+#define BIQUAD_MAX 8.0f // |coefficient| that Q28 holds in an int32_t
+
+static const char *TAG = "WAVBQ";
+
+static int32_t to_q28(float v)
+{
+    return (int32_t)lrintf(v * (float)(1 << BIQUAD_Q));
+}
+
+// coefficients from RBJ Audio EQ Cookbook
+static esp_err_t biquad_prepare(void *ctx, const wav_dsp_format_t *fmt)
+{
+    wav_biquad_t *bq = ctx;
+    float         b0, b1, b2, a0, a1, a2;
+    float         c[5];
+
+    if (!bq || fmt->num_channels > 2)
+        return ESP_ERR_INVALID_ARG;
+
+    if (bq->freq_hz <= 0 || bq->freq_hz >= fmt->sample_rate / 2.0f || bq->q <= 0) {
+        ESP_LOGE(TAG, "bad params f=%.1f q=%.2f for %" PRIu32 " Hz", bq->freq_hz, bq->q, fmt->sample_rate);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float A = powf(10.0f, bq->gain_db / 40.0f);
+    float w0 = 2.0f * (float)M_PI * bq->freq_hz / fmt->sample_rate;
+    float cw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * bq->q);
+    float sa = 2.0f * sqrtf(A) * alpha;
+
+    switch (bq->type) {
+    case WAV_BIQUAD_LOWPASS:
+        b1 = 1.0f - cw;
+        b0 = b2 = b1 / 2.0f;
+        a0 = 1.0f + alpha;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha;
+        break;
+    case WAV_BIQUAD_HIGHPASS:
+        b1 = -(1.0f + cw);
+        b0 = b2 = -b1 / 2.0f;
+        a0 = 1.0f + alpha;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha;
+        break;
+    case WAV_BIQUAD_PEAKING:
+        b0 = 1.0f + alpha * A;
+        b1 = -2.0f * cw;
+        b2 = 1.0f - alpha * A;
+        a0 = 1.0f + alpha / A;
+        a1 = -2.0f * cw;
+        a2 = 1.0f - alpha / A;
+        break;
+    case WAV_BIQUAD_LOWSHELF:
+        b0 = A * ((A + 1) - (A - 1) * cw + sa);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cw);
+        b2 = A * ((A + 1) - (A - 1) * cw - sa);
+        a0 = (A + 1) + (A - 1) * cw + sa;
+        a1 = -2 * ((A - 1) + (A + 1) * cw);
+        a2 = (A + 1) + (A - 1) * cw - sa;
+        break;
+    case WAV_BIQUAD_HIGHSHELF:
+        b0 = A * ((A + 1) + (A - 1) * cw + sa);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cw);
+        b2 = A * ((A + 1) + (A - 1) * cw - sa);
+        a0 = (A + 1) - (A - 1) * cw + sa;
+        a1 = 2 * ((A - 1) - (A + 1) * cw);
+        a2 = (A + 1) - (A - 1) * cw - sa;
+        break;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    c[0] = b0 / a0;
+    c[1] = b1 / a0;
+    c[2] = b2 / a0;
+    c[3] = a1 / a0;
+    c[4] = a2 / a0;
+    for (int i = 0; i < 5; i++) {
+        if (!(fabsf(c[i]) < BIQUAD_MAX)) {
+            ESP_LOGE(TAG, "gain %.1f dB at f=%.1f q=%.2f out of range for %" PRIu32 " Hz", bq->gain_db, bq->freq_hz,
+                     bq->q, fmt->sample_rate);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    bq->b0 = to_q28(c[0]);
+    bq->b1 = to_q28(c[1]);
+    bq->b2 = to_q28(c[2]);
+    bq->a1 = to_q28(c[3]);
+    bq->a2 = to_q28(c[4]);
+    bq->channels = fmt->num_channels;
+
+    memset(bq->x1, 0, sizeof(bq->x1));
+    memset(bq->x2, 0, sizeof(bq->x2));
+    memset(bq->y1, 0, sizeof(bq->y1));
+    memset(bq->y2, 0, sizeof(bq->y2));
+    return ESP_OK;
+}
+
+// direct form I, 64-bit accumulator, output rounded and saturated to 16 bits
+static void biquad_process(void *ctx, void *buf, size_t samples)
+{
+    wav_biquad_t *bq = ctx;
+    int16_t      *s = buf;
+    const int     ch = bq->channels;
+
+    for (int c = 0; c < ch; c++) {
+        int32_t x1 = bq->x1[c], x2 = bq->x2[c];
+        int32_t y1 = bq->y1[c], y2 = bq->y2[c];
+
+        for (size_t i = c; i < samples; i += ch) {
+            int32_t x = s[i];
+            int64_t acc = (int64_t)bq->b0 * x + (int64_t)bq->b1 * x1 + (int64_t)bq->b2 * x2 - (int64_t)bq->a1 * y1 -
+                          (int64_t)bq->a2 * y2;
+            // rounded: a truncation bias would be fed back and grow into a DC offset
+            int32_t y = (int32_t)((acc + (1 << (BIQUAD_Q - 1))) >> BIQUAD_Q);
+
+            if (y > INT16_MAX)
+                y = INT16_MAX;
+            else if (y < INT16_MIN)
+                y = INT16_MIN;
+
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            s[i] = (int16_t)y;
+        }
+        bq->x1[c] = x1;
+        bq->x2[c] = x2;
+        bq->y1[c] = y1;
+        bq->y2[c] = y2;
+    }
+}
+
+const wav_dsp_stage_t wav_dsp_biquad_stage = {
+    .name = "biquad",
+    .formats = WAV_DSP_FMT_MONO | WAV_DSP_FMT_STEREO,
+    .prepare = biquad_prepare,
+    .process = biquad_process,
+};
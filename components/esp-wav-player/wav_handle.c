@@ -1,5 +1,6 @@
 #include "wav_handle.h"
 #include "wav_header.h"
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -9,20 +10,34 @@ static const char *TAG = "WAVH";
 
 wav_handle_t *wav_handle_init(const wav_obj_t *src)
 {
+    wav_handle_t *h;
+
     if (!src)
         return NULL;
 
     switch (src->type) {
     case WAV_SRC_EMBED:
-        return wav_backend_embed_create(src->embed.addr);
+        h = wav_backend_embed_create(src->embed.addr, src->embed.len);
+        break;
 
     case WAV_SRC_SPIFFS:
     case WAV_SRC_MMC:
-        return wav_backend_file_create(src->spiffs.path);
+        h = wav_backend_file_create(src->spiffs.path);
+        break;
+
+    case WAV_SRC_TONE:
+        h = wav_backend_tone_create(src);
+        break;
 
     default:
         return NULL;
     }
+
+    if (h) {
+        h->type = src->type;
+        h->gain_db = src->gain_db;
+    }
+    return h;
 }
 
 void wav_handle_free(wav_handle_t *h)
@@ -31,60 +46,122 @@ void wav_handle_free(wav_handle_t *h)
     free(h);
 }
 
-int wav_parse_header(wav_handle_t *h)
+// skip the body of a chunk, including the pad byte of odd sizes
+static int wav_skip(wav_handle_t *h, size_t *pos, uint32_t size)
 {
-    wav_header_t header;
+    *pos += size + (size & 1);
+    return h->seek(h, *pos);
+}
 
-    // Read full header
-    if (h->read(h, &header, sizeof(header)) != sizeof(header)) {
-        ESP_LOGE(TAG, "header read failed");
+static int wav_check_fmt(const wav_fmt_t *fmt)
+{
+    if (fmt->audio_format != 1) { // PCM
+        ESP_LOGE(TAG, "bad audio_format: %" PRIu16, fmt->audio_format);
         return -1;
     }
 
-    // Validate chunk IDs using memcmp (endianness-safe)
-    if (memcmp(header.riff_header, "RIFF", 4) != 0) {
-        ESP_LOGE(TAG, "riff_header not found");
+    if (fmt->sample_rate < 8000 || fmt->sample_rate > 44100) {
+        ESP_LOGE(TAG, "bad sample_rate = %" PRIu32, fmt->sample_rate);
         return -1;
     }
 
-    if (memcmp(header.wave_header, "WAVE", 4) != 0) {
-        ESP_LOGE(TAG, "wave_header not found");
+    if (fmt->bit_depth != 8 && fmt->bit_depth != 16) {
+        ESP_LOGE(TAG, "bad bit_depth = %" PRIu16, fmt->bit_depth);
+        return -1;
+    }
+
+    if (fmt->num_channels == 0 || fmt->num_channels > WAV_MAX_CHANNELS) {
+        ESP_LOGE(TAG, "bad num_channels = %" PRIu16, fmt->num_channels);
         return -1;
     }
 
-    if (memcmp(header.fmt_header, "fmt ", 4) != 0) {
-        ESP_LOGE(TAG, "fmt_header not found");
+    if (fmt->byte_rate == 0 || fmt->sample_alignment != fmt->num_channels * fmt->bit_depth / 8) {
+        ESP_LOGE(TAG, "bad byte_rate/sample_alignment");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Walk the RIFF chunks up to "data": "fmt " gives the format, the custom
+ * "gain" chunk adds to the clip gain and anything else (LIST, fact, ...)
+ * is skipped.
+ */
+int wav_parse_header(wav_handle_t *h)
+{
+    char        riff[12];
+    wav_chunk_t chunk;
+    wav_fmt_t   fmt;
+    bool        have_fmt = false;
+    size_t      pos;
+
+    if (h->parse)
+        return h->parse(h);
+
+    if (h->read(h, riff, sizeof(riff)) != sizeof(riff)) {
+        ESP_LOGE(TAG, "header read failed");
         return -1;
     }
 
-    if (header.audio_format != 1) { // PCM
-        ESP_LOGE(TAG, "bad audio_format: %" PRIu16, header.audio_format);
+    // Validate chunk IDs using memcmp (endianness-safe)
+    if (memcmp(riff, "RIFF", 4) != 0) {
+        ESP_LOGE(TAG, "riff_header not found");
         return -1;
     }
 
-    if (header.sample_rate < 8000 || header.sample_rate > 44100) {
-        ESP_LOGE(TAG, "bad sample_rate = %" PRIu32, header.sample_rate);
+    if (memcmp(riff + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "wave_header not found");
         return -1;
     }
 
-    if (memcmp(header.data_header, "data", 4) != 0) {
-        ESP_LOGE(TAG, "data_header not found");
+    pos = sizeof(riff);
+    for (int i = 0; i < WAV_MAX_CHUNKS; i++) {
+        if (h->read(h, &chunk, sizeof(chunk)) != sizeof(chunk)) {
+            ESP_LOGE(TAG, "data_header not found");
+            return -1;
+        }
+        pos += sizeof(chunk);
+
+        if (memcmp(chunk.id, "fmt ", 4) == 0) {
+            if (chunk.size < sizeof(fmt) || h->read(h, &fmt, sizeof(fmt)) != sizeof(fmt) || wav_check_fmt(&fmt))
+                return -1;
+            have_fmt = true;
+            if (wav_skip(h, &pos, chunk.size) != 0)
+                return -1;
+        } else if (memcmp(chunk.id, WAV_GAIN_CHUNK_ID, 4) == 0) {
+            wav_gain_chunk_t gain;
+
+            if (chunk.size >= sizeof(gain) && h->read(h, &gain, sizeof(gain)) == sizeof(gain))
+                h->gain_db += gain.gain_cdb / 100.0f;
+            if (wav_skip(h, &pos, chunk.size) != 0)
+                return -1;
+        } else if (memcmp(chunk.id, "data", 4) == 0) {
+            break;
+        } else if (wav_skip(h, &pos, chunk.size) != 0) {
+            ESP_LOGE(TAG, "chunk %.4s truncated", chunk.id);
+            return -1;
+        }
+    }
+
+    if (!have_fmt || memcmp(chunk.id, "data", 4) != 0) {
+        ESP_LOGE(TAG, "%s not found", have_fmt ? "data_header" : "fmt_header");
         return -1;
     }
 
-    ESP_LOGD(TAG, "num_channels=%" PRIu16, header.num_channels);
-    ESP_LOGD(TAG, "sample_rate=%" PRIu32, header.sample_rate);
-    ESP_LOGD(TAG, "byte_rate=%" PRIu32, header.byte_rate);
-    ESP_LOGD(TAG, "sample_alignment=%" PRIu16, header.sample_alignment);
-    ESP_LOGD(TAG, "bit_depth=%" PRIu16, header.bit_depth);
-    ESP_LOGD(TAG, "data_bytes=%" PRIu32, header.data_bytes);
-
-    h->num_channels = header.num_channels;
-    h->sample_rate = header.sample_rate;
-    h->byte_rate = header.byte_rate;
-    h->sample_alignment = header.sample_alignment;
-    h->bit_depth = header.bit_depth;
-    h->data_start = sizeof(wav_header_t) + 8; //8 bytes of RIFF metadata
-    h->data_bytes = header.data_bytes;
-    return h->seek(h, h->data_start);
+    ESP_LOGD(TAG, "num_channels=%" PRIu16, fmt.num_channels);
+    ESP_LOGD(TAG, "sample_rate=%" PRIu32, fmt.sample_rate);
+    ESP_LOGD(TAG, "byte_rate=%" PRIu32, fmt.byte_rate);
+    ESP_LOGD(TAG, "sample_alignment=%" PRIu16, fmt.sample_alignment);
+    ESP_LOGD(TAG, "bit_depth=%" PRIu16, fmt.bit_depth);
+    ESP_LOGD(TAG, "data_bytes=%" PRIu32, chunk.size);
+    ESP_LOGD(TAG, "gain=%.2f dB", h->gain_db);
+
+    h->num_channels = fmt.num_channels;
+    h->sample_rate = fmt.sample_rate;
+    h->byte_rate = fmt.byte_rate;
+    h->sample_alignment = fmt.sample_alignment;
+    h->bit_depth = fmt.bit_depth;
+    h->data_start = pos;
+    h->data_bytes = chunk.size - chunk.size % fmt.sample_alignment;
+    return 0;
 }
@@ -6,15 +6,24 @@
 
 #include "include/wav_object.h"
 
+// mono and stereo only: without a channel map there is no correct downmix of more
+#define WAV_MAX_CHANNELS 2
+
+// chunks looked at before "data" when parsing a header
+#define WAV_MAX_CHUNKS 16
+
 typedef struct wav_handle wav_handle_t;
 
 struct wav_handle {
+    wav_source_type_t type;                                 /*!< Source type, set by wav_handle_init(). */
     void *ctx;                                              /*!< Backend-specific context pointer. */
     int (*open)(wav_handle_t *h);                           /*!< Open/initialize the backend (returns 0 on success). */
     size_t (*read)(wav_handle_t *h, void *buf, size_t len); /*!< Read up to `len` bytes into `buf`. */
     int (*seek)(wav_handle_t *h, size_t offset);            /*!< Seek to `offset` within the WAV data. */
     void (*close)(wav_handle_t *h);                         /*!< Close the backend and release any resources. */
     void (*clean_ctx)(wav_handle_t *h);                     /*!< Optional cleanup function for `ctx`. */
+    int (*parse)(wav_handle_t *h); /*!< Optional: fills the fields below for sources without a RIFF header. */
+    const void *(*map)(wav_handle_t *h, size_t *len); /*!< Optional: like `read`, but returns the data in place. */
 
     /* Filled by wav_parse_header() */
     uint16_t num_channels;     /*!< Number of audio channels. */
@@ -24,10 +33,14 @@ struct wav_handle {
     uint16_t bit_depth;        /*!< Bits per sample (e.g. 16). */
     size_t   data_start;       /*!< Offset (in bytes) from start of file to audio data. */
     size_t   data_bytes;       /*!< Number of bytes in the audio data chunk. */
+    float    gain_db;          /*!< Clip gain: descriptor gain plus the "gain" chunk, if any. */
+
+    int64_t start_at; /*!< Scheduled start time (esp_timer), 0 to start as soon as possible. */
 };
 
-wav_handle_t *wav_backend_embed_create(const uint8_t *start);
+wav_handle_t *wav_backend_embed_create(const uint8_t *start, size_t len);
 wav_handle_t *wav_backend_file_create(const char *path);
+wav_handle_t *wav_backend_tone_create(const wav_obj_t *src);
 
 // backend-independent creator
 wav_handle_t *wav_handle_init(const wav_obj_t *src);
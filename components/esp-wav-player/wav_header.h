@@ -28,4 +28,31 @@ typedef struct wav_header {
     uint32_t data_bytes;     /*!< Number of bytes in the data chunk (samples * frame_size). */
 } wav_header_t;
 
+/* Generic RIFF chunk header, followed by `size` bytes and a pad byte when `size` is odd */
+typedef struct wav_chunk {
+    char     id[4]; /*!< ASCII chunk tag, e.g. "fmt " or "data". */
+    uint32_t size;  /*!< Size of the chunk body, without the pad byte. */
+} wav_chunk_t;
+
+/* Body of the "fmt " chunk, extensible formats append more fields */
+typedef struct wav_fmt {
+    uint16_t audio_format;     /*!< Audio format (1 = PCM). */
+    uint16_t num_channels;     /*!< Number of audio channels. */
+    uint32_t sample_rate;      /*!< Sampling rate in Hz. */
+    uint32_t byte_rate;        /*!< Bytes per second. */
+    uint16_t sample_alignment; /*!< Block alignment. */
+    uint16_t bit_depth;        /*!< Bits per sample. */
+} wav_fmt_t;
+
+/*
+ * Custom "gain" chunk with the level correction of a clip, written by
+ * gen-wav-assets.py. Players that don't know it skip it like any other chunk.
+ */
+#define WAV_GAIN_CHUNK_ID "gain"
+
+typedef struct wav_gain_chunk {
+    int16_t gain_cdb; /*!< Gain in hundredths of a dB. */
+    int16_t reserved; /*!< Zero. */
+} wav_gain_chunk_t;
+
 #endif /* _WAV_HEADER_H_ */
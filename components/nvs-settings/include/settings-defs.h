@@ -123,6 +123,10 @@ typedef union {
  * - `label`: human-readable label for UI or logs
  * - `type`: one of `setting_type_t` describing active union member
  * - `disabled`: if true, setting is not editable or exposed
+ * - `dirty`: changed since it was last read from or written to NVS; set by the
+ *   setter APIs and the HTTP handler, call `setting_mark_changed()` after changing
+ *   `val` directly
+ * - `gen`: settings generation of the last change, see `settings_generation()`
  * - union: contains the typed current value and default/meta information
  */
 typedef struct {
@@ -130,6 +134,8 @@ typedef struct {
     const char    *label; //more descriptive
     setting_type_t type;
     bool           disabled;
+    bool           dirty;
+    uint32_t       gen;
     union {
         setting_bool_t  boolean;
         setting_int_t   num;
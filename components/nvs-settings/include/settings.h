@@ -25,6 +25,29 @@
  */
 typedef esp_err_t (*settings_handler_t)(const settings_group_t *settings, void *arg);
 
+/**
+ * @brief Type of callback notified about the change of a single setting.
+ *
+ * @param group Group of the changed setting.
+ * @param setting The setting, holding its new value.
+ * @param old Copy of the setting with the value at the previous notification (or at subscription time).
+ * @param arg User-provided argument passed to `settings_subscribe()`.
+ */
+typedef void (*settings_change_cb_t)(const settings_group_t *group, const setting_t *setting, const setting_t *old,
+                                     void *arg);
+
+/**
+ * @brief Handle to a resolved setting.
+ *
+ * Resolve a setting once with `setting_ref_resolve()`, then read and write
+ * it through the handle without any string comparison.
+ */
+typedef struct {
+    setting_t              *setting; /*!< The resolved setting. */
+    const settings_group_t *group;   /*!< Group the setting belongs to. */
+    uint16_t                index;   /*!< Position of the setting in the pack, counted across groups. */
+} setting_ref_t;
+
 /**
  * @brief Print a settings group to the console/log.
  *
@@ -39,7 +62,8 @@ void settings_pack_print(const settings_group_t *settings);
  * @brief Find a setting by group and identifier.
  *
  * Searches the provided settings pack for a setting that belongs to the
- * group named @p gr and has the identifier @p id.
+ * group named @p gr and has the identifier @p id. Uses the pack index when
+ * one was built by `settings_pack_index()`, a linear search otherwise.
  *
  * @param settings Pointer to the settings pack to search. Must not be NULL.
  * @param gr Null-terminated group name to search for.
@@ -48,6 +72,114 @@ void settings_pack_print(const settings_group_t *settings);
  */
 setting_t *settings_pack_find(const settings_group_t *settings, const char *gr, const char *id);
 
+/**
+ * @brief Build the lookup index of a settings pack.
+ *
+ * Hashes every `group:setting` id once, so that `settings_pack_find()` and
+ * `setting_ref_resolve()` no longer compare strings against every setting.
+ * Called by `settings_nvs_read()`; calling it again for the same pack does
+ * nothing. Call it at startup, before other tasks use the pack.
+ *
+ * @param settings Pointer to the settings pack. Must not be NULL.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_NO_MEM if the index could not be allocated
+ *     - ESP_ERR_INVALID_SIZE if the pack has 65535 settings or more
+ */
+esp_err_t settings_pack_index(const settings_group_t *settings);
+
+/**
+ * @brief Resolve a setting to a handle.
+ *
+ * @param settings Pointer to the settings pack to search. Must not be NULL.
+ * @param gr Null-terminated group id.
+ * @param id Null-terminated setting id.
+ * @param[out] ref Handle to fill in.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no such setting.
+ */
+esp_err_t setting_ref_resolve(const settings_group_t *settings, const char *gr, const char *id, setting_ref_t *ref);
+
+/**
+ * @brief Value of a `SETTING_TYPE_BOOL` setting.
+ */
+static inline bool setting_ref_get_bool(const setting_ref_t *ref)
+{
+    return ref->setting->boolean.val;
+}
+
+/**
+ * @brief Value of a `SETTING_TYPE_NUM` setting, or option index of a `SETTING_TYPE_ONEOF` setting.
+ */
+static inline int setting_ref_get_int(const setting_ref_t *ref)
+{
+    return ref->setting->type == SETTING_TYPE_ONEOF ? ref->setting->oneof.val : ref->setting->num.val;
+}
+
+/**
+ * @brief Value of a `SETTING_TYPE_TEXT` or `SETTING_TYPE_TIMEZONE` setting.
+ */
+static inline const char *setting_ref_get_text(const setting_ref_t *ref)
+{
+    return ref->setting->text.val;
+}
+
+/**
+ * @brief Set a `SETTING_TYPE_BOOL` setting.
+ *
+ * Like the other setters, marks the setting dirty when the value changes.
+ *
+ * @param ref Resolved setting.
+ * @param val New value.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the setting has another type.
+ */
+esp_err_t setting_ref_set_bool(const setting_ref_t *ref, bool val);
+
+/**
+ * @brief Set a `SETTING_TYPE_NUM` setting or the option index of a `SETTING_TYPE_ONEOF` setting.
+ *
+ * @param ref Resolved setting.
+ * @param val New value.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_ARG if the value is out of range or not a valid option
+ *     - ESP_ERR_INVALID_STATE if the setting has another type
+ */
+esp_err_t setting_ref_set_int(const setting_ref_t *ref, int val);
+
+/**
+ * @brief Set a `SETTING_TYPE_TEXT` or `SETTING_TYPE_TIMEZONE` setting.
+ *
+ * @param ref Resolved setting.
+ * @param val Null-terminated new value.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_SIZE if the value does not fit the setting buffer
+ *     - ESP_ERR_INVALID_STATE if the setting has another type
+ */
+esp_err_t setting_ref_set_text(const setting_ref_t *ref, const char *val);
+
+/**
+ * @brief Record a change of a setting made by writing its value directly.
+ *
+ * Marks @p setting dirty, so the next `settings_nvs_write()` stores it, and
+ * stamps it with a new settings generation. The setter APIs and the HTTP
+ * handler do this themselves.
+ *
+ * @param setting Changed setting.
+ */
+void setting_mark_changed(setting_t *setting);
+
+/**
+ * @brief Current settings generation.
+ *
+ * A counter that increments on every setting change. The HTTP handlers join it
+ * with a per-boot id as `<boot>-<gen>`, which is sent as the `ETag` of the
+ * settings JSON and accepted by `?since=<boot>-<gen>` requests.
+ *
+ * @return uint32_t Generation of the most recent change, 0 before the first change.
+ */
+uint32_t settings_generation(void);
+
 /**
  * @brief Initialize a single setting to its default value.
  *
@@ -83,20 +215,33 @@ esp_err_t settings_nvs_read(const settings_group_t *settings);
 /**
  * @brief Write the provided settings pack to NVS.
  *
- * Persists all relevant settings contained in @p settings to non-volatile
- * storage so they survive reboots.
+ * Persists the settings of @p settings that changed since they were last
+ * read or written (see `dirty` in `setting_t`), so saving one changed
+ * value writes one NVS entry instead of the whole pack.
  *
  * @param settings Pointer to the settings pack to persist. Must not be NULL.
  * @return esp_err_t ESP_OK on success; otherwise an error code from esp_err.h.
  */
 esp_err_t settings_nvs_write(const settings_group_t *settings);
 
+/**
+ * @brief Write the changed settings to NVS and report how many entries were written.
+ *
+ * Same as `settings_nvs_write()`.
+ *
+ * @param settings Pointer to the settings pack to persist. Must not be NULL.
+ * @param[out] written Number of NVS entries written, may be NULL.
+ * @return esp_err_t ESP_OK on success; otherwise an error code from esp_err.h.
+ */
+esp_err_t settings_nvs_write_changed(const settings_group_t *settings, size_t *written);
+
 /**
  * @brief Erase all settings stored in NVS.
  *
- * Removes the settings namespace from NVS. Use with care — this is not
- * reversible and will remove persisted configuration.
- * 
+ * Removes the settings namespace from NVS and resets @p settings to their
+ * defaults, so the values in RAM match what a later read would load. Use with
+ * care — this is not reversible and will remove persisted configuration.
+ *
  * @param settings Pointer to the settings pack to populate. Must not be NULL.
  * @return esp_err_t ESP_OK on success; otherwise an error code from esp_err.h.
  */
@@ -115,15 +260,90 @@ esp_err_t settings_nvs_erase(settings_group_t *settings);
  */
 esp_err_t settings_handler_register(settings_handler_t handler, void *arg);
 
+/**
+ * @brief Subscribe to changes of one setting or of a whole group.
+ *
+ * The subscriber list of each setting is built here, so a notification only
+ * calls the subscribers of the settings that actually changed, once per
+ * changed setting with its old and new value. Any number of subscribers can
+ * watch the same setting; they are called in subscription order. Subscribe
+ * during initialization, before the settings are served over HTTP.
+ *
+ * @param settings_pack Settings pack the setting belongs to.
+ * @param gr_id Group id.
+ * @param id Setting id, NULL to subscribe to every setting of the group.
+ * @param cb Callback to invoke.
+ * @param arg User-defined argument passed to @p cb.
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_NOT_FOUND if there is no such group or setting
+ *     - ESP_ERR_NO_MEM if the subscription could not be allocated
+ */
+esp_err_t settings_subscribe(const settings_group_t *settings_pack, const char *gr_id, const char *id,
+                             settings_change_cb_t cb, void *arg);
+
+/**
+ * @brief Notify subscribers about the settings changed since the last notification.
+ *
+ * Called by the HTTP handler after applying a request, next to the handler
+ * registered with `settings_handler_register()`. Call it after changing
+ * settings from application code, e.g. after `settings_nvs_write()`.
+ * Changes made by a callback itself are not reported again.
+ *
+ * @param settings_pack Settings pack to check.
+ */
+void settings_notify(const settings_group_t *settings_pack);
+
 /**
  * @brief HTTP server handler for serving or updating settings.
  *
  * This function is intended to be used as an ESP HTTPD request handler
  * and implements the settings HTTP endpoint.
  *
+ * GET returns the whole pack as JSON. POST with `?action=set` applies a
+ * urlencoded form. PATCH (or POST with `?action=patch`) applies a JSON object
+ * of changed values, e.g. `{"DEV:DISPBR": 3}`, and replies with the settings
+ * that actually changed.
+ *
+ * Responses carry `"<boot>-<gen>"` as `ETag`; a GET with a matching
+ * `If-None-Match` gets `304 Not Modified`. DATETIME values are read from the
+ * clock when a reply is built and are not part of the `ETag`, so after a 304
+ * the client's copy is as old as its cached reply. GET with
+ * `?since=<boot>-<gen>` returns the reply of `settings_values_httpd_handler()`.
+ *
  * @param req Pointer to the HTTP request provided by the ESP HTTP server.
  * @return esp_err_t ESP_OK if the request was handled successfully; otherwise an error code.
  */
 esp_err_t settings_httpd_handler(httpd_req_t *req);
 
+/**
+ * @brief HTTP handler serving the schema of a settings pack.
+ *
+ * Replies with the groups and settings of the pack in `user_ctx`: labels,
+ * ids, types, defaults, ranges and options, without values. The document
+ * only changes with the firmware, so it is sent with a hash as `ETag`;
+ * requested as `?h=<hash>` (see `settings_values_httpd_handler()`) it is
+ * marked cacheable for a year. The document is streamed from the pack for
+ * every request, not stored.
+ *
+ * @param req Pointer to the HTTP request provided by the ESP HTTP server.
+ * @return esp_err_t ESP_OK if the request was handled successfully; otherwise an error code.
+ */
+esp_err_t settings_schema_httpd_handler(httpd_req_t *req);
+
+/**
+ * @brief HTTP handler serving only the current values of a settings pack.
+ *
+ * Replies with `{"gen": "<boot>-<gen>", "schema": "<hash>", "data": {"GROUP:ID": value, ...}}`
+ * for the pack in `user_ctx`, values in the notation of a PATCH request.
+ * `?since=<boot>-<gen>` with a `gen` of an earlier reply limits `data` to the
+ * settings changed after it; a token from another boot returns all values.
+ * The `ETag` and `304 Not Modified` handling is the same as for
+ * `settings_httpd_handler()`.
+ *
+ * @param req Pointer to the HTTP request provided by the ESP HTTP server.
+ * @return esp_err_t ESP_OK if the request was handled successfully; otherwise an error code.
+ */
+esp_err_t settings_values_httpd_handler(httpd_req_t *req);
+
 #endif /* SETTINGS_H_ */
@@ -1,4 +1,5 @@
 #include "include/settings.h"
+#include "settings_priv.h"
 
 #include <stdio.h>
 #include <time.h>
@@ -7,14 +8,24 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <nvs_flash.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_random.h>
+#endif
+#include <inttypes.h>
 #include <cJSON.h>
 
 static const char *TAG = "SETTINGS";
 static const char *NVS_STORAGE = "settings_nvs";
 
+#define PATCH_MAX_LEN 4096 /* largest accepted JSON patch body */
+
 static settings_handler_t settings_handler;
 static void              *handler_arg;
 
+static uint32_t generation; /* bumped on every change, see setting_mark_changed() */
+static uint32_t boot_id;    /* tells ETags of different boots apart */
+
 #ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
 static void datetime_gettimeofday(setting_datetime_t *setting)
 {
@@ -108,6 +119,13 @@ void settings_pack_print(const settings_group_t *settings_pack)
 
 setting_t *settings_pack_find(const settings_group_t *pack, const char *gr_id, const char *id)
 {
+    const settings_index_t *idx = settings_index_get(pack);
+
+    if (idx) {
+        const settings_entry_t *e = settings_index_lookup(idx, gr_id, id);
+        return e ? e->setting : NULL;
+    }
+
     for (const settings_group_t *gr = pack; gr->id; gr++) {
         if (strcmp(gr_id, gr->id))
             continue;
@@ -119,8 +137,31 @@ setting_t *settings_pack_find(const settings_group_t *pack, const char *gr_id, c
     return NULL;
 }
 
+void setting_mark_changed(setting_t *setting)
+{
+    setting->dirty = true;
+    setting->gen = ++generation;
+}
+
+uint32_t settings_generation(void)
+{
+    return generation;
+}
+
+// text values live outside setting_t, so they are compared before the copy
+static void setting_text_update(setting_t *setting, setting_text_t *text, const char *val)
+{
+    if (strncmp(text->val, val, text->len)) {
+        strncpy(text->val, val, text->len);
+        setting_mark_changed(setting);
+    }
+}
+
 void setting_set_defaults(setting_t *setting)
 {
+    setting_t prev;
+
+    memcpy(&prev, setting, sizeof(prev));
     switch (setting->type) {
     case SETTING_TYPE_BOOL:
         setting->boolean.val = setting->boolean.def;
@@ -132,7 +173,7 @@ void setting_set_defaults(setting_t *setting)
         setting->oneof.val = setting->oneof.def;
         break;
     case SETTING_TYPE_TEXT:
-        strncpy(setting->text.val, setting->text.def, setting->text.len);
+        setting_text_update(setting, &setting->text, setting->text.def);
         break;
 #ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
     case SETTING_TYPE_TIME:
@@ -147,7 +188,7 @@ void setting_set_defaults(setting_t *setting)
 #endif
 #ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
     case SETTING_TYPE_TIMEZONE:
-        strncpy(setting->timezone.val, setting->timezone.def, setting->timezone.len);
+        setting_text_update(setting, &setting->timezone, setting->timezone.def);
         break;
 #endif
 #ifdef CONFIG_SETTINGS_COLOR_SUPPORT
@@ -157,6 +198,8 @@ void setting_set_defaults(setting_t *setting)
     default:
         break;
     }
+    if (memcmp(&prev, setting, sizeof(prev)))
+        setting_mark_changed(setting);
 }
 
 void settings_pack_set_defaults(const settings_group_t *settings_pack)
@@ -167,146 +210,377 @@ void settings_pack_set_defaults(const settings_group_t *settings_pack)
     }
 }
 
+// values match NVS again
+static void settings_pack_clear_dirty(const settings_group_t *settings_pack)
+{
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++)
+            setting->dirty = false;
+    }
+}
+
+// read one setting stored under its own key, ESP_ERR_NOT_SUPPORTED for types that are not stored
+static esp_err_t setting_nvs_get(nvs_handle nvs, const char *nvs_id, setting_t *setting)
+{
+    esp_err_t rc;
+
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL:
+        return nvs_get_i8(nvs, nvs_id, (int8_t *)&setting->boolean.val);
+    case SETTING_TYPE_NUM:
+        return nvs_get_i32(nvs, nvs_id, (int32_t *)&setting->num.val);
+    case SETTING_TYPE_ONEOF:
+        return nvs_get_i8(nvs, nvs_id, (int8_t *)&setting->oneof.val);
+    case SETTING_TYPE_TEXT: {
+        size_t len = setting->text.len;
+        return nvs_get_str(nvs, nvs_id, setting->text.val, &len);
+    }
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        uint16_t val;
+        rc = nvs_get_u16(nvs, nvs_id, &val);
+        if (rc == ESP_OK) {
+            setting->time.hh = (val >> 8);
+            setting->time.mm = (val & 0xFF);
+        }
+        return rc;
+    }
+    case SETTING_TYPE_DATE: {
+        uint32_t val;
+        rc = nvs_get_u32(nvs, nvs_id, &val);
+        if (rc == ESP_OK) {
+            setting->date.day = (val >> 24 & 0xFF);
+            setting->date.month = (val >> 16 & 0xFF);
+            setting->date.year = (val & 0xFFFF);
+        }
+        return rc;
+    }
+#endif
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE: {
+        size_t len = setting->timezone.len;
+        return nvs_get_str(nvs, nvs_id, setting->timezone.val, &len);
+    }
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR:
+        return nvs_get_u32(nvs, nvs_id, &setting->color.combined);
+#endif
+    default:
+        /* DATETIME is the current date and time on device, set with the defaults */
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+#ifndef CONFIG_SETTINGS_STORAGE_BLOB
+// store one setting under its own key
+static esp_err_t setting_nvs_set(nvs_handle nvs, const char *nvs_id, const setting_t *setting)
+{
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL:
+        return nvs_set_i8(nvs, nvs_id, setting->boolean.val);
+    case SETTING_TYPE_NUM:
+        return nvs_set_i32(nvs, nvs_id, setting->num.val);
+    case SETTING_TYPE_ONEOF:
+        return nvs_set_i8(nvs, nvs_id, setting->oneof.val);
+    case SETTING_TYPE_TEXT:
+        return nvs_set_str(nvs, nvs_id, setting->text.val);
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        uint16_t val = (setting->time.hh << 8) | setting->time.mm;
+        return nvs_set_u16(nvs, nvs_id, val);
+    }
+    case SETTING_TYPE_DATE: {
+        uint32_t val = 0;
+        val |= ((uint32_t)(setting->date.day & 0xFF) << 24);
+        val |= ((uint32_t)(setting->date.month & 0xFF) << 16);
+        val |= ((uint32_t)(setting->date.year & 0xFFFF));
+        return nvs_set_u32(nvs, nvs_id, val);
+    }
+#endif
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE:
+        return nvs_set_str(nvs, nvs_id, setting->timezone.val);
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR:
+        return nvs_set_u32(nvs, nvs_id, setting->color.combined);
+#endif
+    default:
+        return ESP_OK;
+    }
+}
+#endif
+
+// read the settings of a group stored one per key, returns the number of keys found
+static size_t settings_group_read_keys(nvs_handle nvs, const settings_group_t *gr)
+{
+    char   nvs_id[128];
+    size_t found = 0;
+
+    for (setting_t *setting = gr->settings; setting->id; setting++) {
+        snprintf(nvs_id, sizeof(nvs_id), "%s:%s", gr->id, setting->id);
+        if (setting_nvs_get(nvs, nvs_id, setting) == ESP_OK)
+            found++;
+    }
+    return found;
+}
+
+// nvs_entry_find()/nvs_entry_next() return an error code since IDF 5.0
+static nvs_iterator_t settings_nvs_entries(void)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    nvs_iterator_t it = NULL;
+
+    if (nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_STORAGE, NVS_TYPE_ANY, &it) != ESP_OK) {
+        nvs_release_iterator(it);
+        return NULL;
+    }
+    return it;
+#else
+    return nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_STORAGE, NVS_TYPE_ANY);
+#endif
+}
+
+static nvs_iterator_t settings_nvs_next_entry(nvs_iterator_t it)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    if (nvs_entry_next(&it) != ESP_OK) {
+        nvs_release_iterator(it);
+        return NULL;
+    }
+    return it;
+#else
+    return nvs_entry_next(it);
+#endif
+}
+
+/*
+ * Load a pack in one pass over the stored entries, each dispatched to its
+ * setting through the index, so the cost follows what is stored rather than
+ * what is declared. In blob mode, settings found under old per-setting keys
+ * are marked dirty for migration.
+ */
+static void settings_pack_load(nvs_handle nvs, const settings_group_t *settings_pack, const settings_index_t *idx)
+{
+    nvs_entry_info_t info;
+
+    for (nvs_iterator_t it = settings_nvs_entries(); it; it = settings_nvs_next_entry(it)) {
+        const settings_entry_t *e;
+
+        nvs_entry_info(it, &info);
+        if (!strchr(info.key, ':')) {
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+            for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+                if (info.type == NVS_TYPE_BLOB && !strcmp(gr->id, info.key)) {
+                    esp_err_t rc = settings_blob_read(nvs, gr);
+                    if (rc != ESP_OK)
+                        ESP_LOGW(TAG, "group %s blob: %s", gr->id, esp_err_to_name(rc));
+                    break;
+                }
+            }
+#endif
+            continue;
+        }
+
+        e = settings_index_lookup_key(idx, info.key);
+        if (!e)
+            continue; /* stale entry of a removed setting */
+
+        if (setting_nvs_get(nvs, info.key, e->setting) != ESP_OK)
+            ESP_LOGW(TAG, "nvs get %s failed", info.key);
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+        else
+            e->setting->dirty = true;
+#endif
+    }
+}
+
+// keyed reads of every declared setting, used when the pack has no index
+static void settings_pack_lookup(nvs_handle nvs, const settings_group_t *settings_pack)
+{
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+        esp_err_t rc = settings_blob_read(nvs, gr);
+
+        if (rc == ESP_ERR_NVS_NOT_FOUND) {
+            // no blob yet, pick up values stored one per key by an older firmware
+            if (settings_group_read_keys(nvs, gr)) {
+                for (setting_t *setting = gr->settings; setting->id; setting++)
+                    setting->dirty = true;
+            }
+        } else if (rc != ESP_OK) {
+            ESP_LOGW(TAG, "group %s blob: %s", gr->id, esp_err_to_name(rc));
+        }
+#else
+        settings_group_read_keys(nvs, gr);
+#endif
+    }
+}
+
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+// store a changed group as one blob under the group id
+static esp_err_t settings_group_write(nvs_handle nvs, const settings_group_t *gr)
+{
+    size_t    id_len;
+    esp_err_t rc;
+
+    id_len = strnlen(gr->id, NVS_KEY_NAME_MAX_SIZE);
+    if (id_len >= NVS_KEY_NAME_MAX_SIZE) {
+        ESP_LOGE(TAG, "NVS key too long (>= %d): %s", NVS_KEY_NAME_MAX_SIZE, gr->id);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rc = settings_blob_write(nvs, gr);
+    if (rc != ESP_OK) {
+        ESP_LOGE(TAG, "nvs set: %s", esp_err_to_name(rc));
+        return rc;
+    }
+    for (setting_t *setting = gr->settings; setting->id; setting++)
+        setting->dirty = false;
+    return ESP_OK;
+}
+
+// move a group read from per-setting keys into its blob, the keys are removed once the blob is stored
+static esp_err_t settings_group_migrate(nvs_handle nvs, const settings_group_t *gr)
+{
+    char      nvs_id[128];
+    esp_err_t rc;
+
+    rc = settings_group_write(nvs, gr);
+    if (rc != ESP_OK)
+        return rc;
+
+    for (setting_t *setting = gr->settings; setting->id; setting++) {
+        snprintf(nvs_id, sizeof(nvs_id), "%s:%s", gr->id, setting->id);
+        nvs_erase_key(nvs, nvs_id);
+    }
+    ESP_LOGI(TAG, "group %s migrated to blob", gr->id);
+    return ESP_OK;
+}
+#endif
+
 esp_err_t settings_nvs_read(const settings_group_t *settings_pack)
 {
-    char       nvs_id[128];
     nvs_handle nvs;
     esp_err_t  rc;
 
     ESP_LOGI(TAG, "NVS init");
     nvs_flash_init();
+    settings_pack_index(settings_pack);
 
     settings_pack_set_defaults(settings_pack);
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+    /* read-write, so groups still stored per key can be migrated */
+    rc = nvs_open(NVS_STORAGE, NVS_READWRITE, &nvs);
+#else
     rc = nvs_open(NVS_STORAGE, NVS_READONLY, &nvs);
+#endif
     if (rc == ESP_OK) {
+        const settings_index_t *idx = settings_index_get(settings_pack);
+
+        settings_pack_clear_dirty(settings_pack);
+        if (idx)
+            settings_pack_load(nvs, settings_pack, idx);
+        else
+            settings_pack_lookup(nvs, settings_pack);
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+        bool migrated = false;
+
         for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
             for (setting_t *setting = gr->settings; setting->id; setting++) {
-                sprintf(nvs_id, "%s:%s", gr->id, setting->id);
-                switch (setting->type) {
-                case SETTING_TYPE_BOOL: {
-                    nvs_get_i8(nvs, nvs_id, (int8_t *)&setting->boolean.val);
-                } break;
-                case SETTING_TYPE_NUM: {
-                    nvs_get_i32(nvs, nvs_id, (int32_t *)&setting->num.val);
-                } break;
-                case SETTING_TYPE_ONEOF: {
-                    nvs_get_i8(nvs, nvs_id, (int8_t *)&setting->oneof.val);
-                } break;
-                case SETTING_TYPE_TEXT: {
-                    size_t len = setting->text.len;
-                    nvs_get_str(nvs, nvs_id, setting->text.val, &len);
-                } break;
-#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
-                case SETTING_TYPE_TIME: {
-                    uint16_t val;
-                    nvs_get_u16(nvs, nvs_id, &val);
-                    setting->time.hh = (val >> 8);
-                    setting->time.mm = (val & 0xFF);
-                } break;
-                case SETTING_TYPE_DATE: {
-                    uint32_t val;
-                    nvs_get_u32(nvs, nvs_id, &val);
-                    setting->date.day = (val >> 24 & 0xFF);
-                    setting->date.month = (val >> 16 & 0xFF);
-                    setting->date.year = (val & 0xFFFF);
-                } break;
-                case SETTING_TYPE_DATETIME:
-                    /* this is current date and time on device not from nvs */
-                    datetime_gettimeofday(&setting->datetime);
-                    break;
-#endif
-#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
-                case SETTING_TYPE_TIMEZONE: {
-                    size_t len = setting->timezone.len;
-                    nvs_get_str(nvs, nvs_id, setting->timezone.val, &len);
-                } break;
-#endif
-#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
-                case SETTING_TYPE_COLOR: {
-                    nvs_get_u32(nvs, nvs_id, &setting->color.combined);
-                } break;
-#endif
-                default:
+                if (setting->dirty) {
+                    migrated |= settings_group_migrate(nvs, gr) == ESP_OK;
                     break;
                 }
             }
         }
+        if (migrated)
+            nvs_commit(nvs);
+#endif
         nvs_close(nvs);
     } else {
         ESP_LOGW(TAG, "nvs open error %s", esp_err_to_name(rc));
     }
+    settings_pack_clear_dirty(settings_pack);
+
+    // loaded values bypass setting_mark_changed(), so they all count as one change
+    generation++;
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++)
+            setting->gen = generation;
+    }
     return ESP_OK;
 }
 
 esp_err_t settings_nvs_write(const settings_group_t *settings_pack)
 {
-    char       nvs_id[128];
-    uint8_t    id_len;
+    return settings_nvs_write_changed(settings_pack, NULL);
+}
+
+esp_err_t settings_nvs_write_changed(const settings_group_t *settings_pack, size_t *written)
+{
     nvs_handle nvs;
     esp_err_t  rc;
+    size_t     changed = 0;
+    size_t     stored = 0;
+
+    if (written)
+        *written = 0;
 
     rc = nvs_open(NVS_STORAGE, NVS_READWRITE, &nvs);
     if (rc == ESP_OK) {
         for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+            bool group_dirty = false;
+#endif
             for (setting_t *setting = gr->settings; setting->id; setting++) {
-                snprintf(nvs_id, sizeof(nvs_id), "%s:%s", gr->id, setting->id);
+                if (!setting->dirty)
+                    continue;
 
+                changed++;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+                if (setting->type == SETTING_TYPE_DATETIME) {
+                    /* set date and time on device - do not store in nvs */
+                    if (datetime_settimeofday(&setting->datetime) == 0)
+                        setting->dirty = false;
+                    continue;
+                }
+#endif
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+                group_dirty = true;
+#else
+                char    nvs_id[128];
+                uint8_t id_len;
+
+                snprintf(nvs_id, sizeof(nvs_id), "%s:%s", gr->id, setting->id);
                 id_len = strnlen(nvs_id, sizeof(nvs_id));
                 if (id_len >= NVS_KEY_NAME_MAX_SIZE - 1) {
                     ESP_LOGE(TAG, "NVS key too long (%u >= %d): %s", id_len, NVS_KEY_NAME_MAX_SIZE - 1, nvs_id);
-                    rc = ESP_ERR_INVALID_ARG;
                     continue;
                 }
 
-                switch (setting->type) {
-                case SETTING_TYPE_BOOL:
-                    rc = nvs_set_i8(nvs, nvs_id, setting->boolean.val);
-                    break;
-                case SETTING_TYPE_NUM:
-                    rc = nvs_set_i32(nvs, nvs_id, setting->num.val);
-                    break;
-                case SETTING_TYPE_ONEOF:
-                    rc = nvs_set_i8(nvs, nvs_id, setting->oneof.val);
-                    break;
-                case SETTING_TYPE_TEXT:
-                    nvs_set_str(nvs, nvs_id, setting->text.val);
-                    break;
-#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
-                case SETTING_TYPE_TIME: {
-                    uint16_t val = (setting->time.hh << 8) | setting->time.mm;
-                    rc = nvs_set_u16(nvs, nvs_id, val);
-                } break;
-                case SETTING_TYPE_DATE: {
-                    uint32_t val = 0;
-                    val |= ((uint32_t)(setting->date.day & 0xFF) << 24);
-                    val |= ((uint32_t)(setting->date.month & 0xFF) << 16);
-                    val |= ((uint32_t)(setting->date.year & 0xFFFF));
-                    rc = nvs_set_u32(nvs, nvs_id, val);
-                } break;
-                case SETTING_TYPE_DATETIME:
-                    /* set date and time on device - do not store in nvs */
-                    rc = datetime_settimeofday(&setting->datetime);
-                    break;
-#endif
-#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
-                case SETTING_TYPE_TIMEZONE:
-                    rc = nvs_set_str(nvs, nvs_id, setting->timezone.val);
-                    break;
-#endif
-#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
-                case SETTING_TYPE_COLOR: {
-                    rc = nvs_set_u32(nvs, nvs_id, setting->color.combined);
-                } break;
-#endif
-                default:
-                    break;
-                }
-                if (rc != ESP_OK)
+                rc = setting_nvs_set(nvs, nvs_id, setting);
+                if (rc != ESP_OK) {
                     ESP_LOGE(TAG, "nvs set: %s", esp_err_to_name(rc));
+                    continue;
+                }
+                setting->dirty = false;
+                stored++;
+#endif
             }
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+            /* the whole group is one entry */
+            if (group_dirty && settings_group_write(nvs, gr) == ESP_OK)
+                stored++;
+#endif
         }
-        nvs_commit(nvs);
+        if (stored)
+            nvs_commit(nvs);
         nvs_close(nvs);
+        ESP_LOGI(TAG, "nvs write: %zu changed settings, %zu entries written", changed, stored);
+        if (written)
+            *written = stored;
     } else {
         ESP_LOGE(TAG, "nvs open error %s", esp_err_to_name(rc));
         return rc;
@@ -314,6 +588,14 @@ esp_err_t settings_nvs_write(const settings_group_t *settings_pack)
     return ESP_OK;
 }
 
+// tell subscribers and the registered handler about applied changes
+static void settings_changed(const settings_group_t *settings_pack)
+{
+    settings_notify(settings_pack);
+    if (settings_handler != NULL)
+        settings_handler(settings_pack, handler_arg);
+}
+
 esp_err_t settings_nvs_erase(settings_group_t *settings_pack)
 {
     nvs_handle nvs;
@@ -321,9 +603,13 @@ esp_err_t settings_nvs_erase(settings_group_t *settings_pack)
     rc = nvs_open(NVS_STORAGE, NVS_READWRITE, &nvs);
     if (rc == ESP_OK) {
         nvs_erase_all(nvs);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+        // an empty namespace reads back as defaults, so RAM gets them too
+        settings_pack_set_defaults(settings_pack);
+        settings_pack_clear_dirty(settings_pack);
         ESP_LOGW(TAG, "nvs erased");
-        if (settings_handler != NULL)
-            settings_handler(settings_pack, handler_arg);
+        settings_changed(settings_pack);
     } else {
         ESP_LOGE(TAG, "nvs open error %s", esp_err_to_name(rc));
     }
@@ -337,26 +623,9 @@ esp_err_t settings_handler_register(settings_handler_t handler, void *arg)
     return ESP_OK;
 }
 
-static esp_err_t send_json_response(cJSON *js, httpd_req_t *req)
+// labels, types, defaults and ranges of a pack, with the current values if `values`
+static void settings_pack_to_json(settings_json_t *js, const char *key, settings_group_t *settings_pack, bool values)
 {
-    char *js_txt = cJSON_Print(js);
-    cJSON_Delete(js);
-
-    httpd_resp_set_type(req, HTTPD_TYPE_JSON);
-    httpd_resp_send(req, js_txt, -1);
-    free(js_txt);
-    return ESP_OK;
-}
-
-static cJSON *settings_pack_to_json(settings_group_t *settings_pack)
-{
-    cJSON *js_groups;
-    cJSON *js_group;
-    cJSON *js_settings;
-    cJSON *js_setting;
-    cJSON *js_labels;
-    cJSON *js;
-
     const char *types[] = {
         [SETTING_TYPE_BOOL] = "BOOL",         [SETTING_TYPE_NUM] = "NUM",   [SETTING_TYPE_ONEOF] = "ONEOF",
         [SETTING_TYPE_TEXT] = "TEXT",
@@ -371,180 +640,221 @@ static cJSON *settings_pack_to_json(settings_group_t *settings_pack)
 #endif
     };
 
-    if (!settings_pack)
-        return NULL;
+    if (!settings_pack) {
+        settings_json_add_string(js, key, NULL);
+        return;
+    }
 
-    js_groups = cJSON_CreateArray();
+    settings_json_begin_object(js, key);
+    settings_json_begin_array(js, "groups");
     for (settings_group_t *gr = settings_pack; gr->label; gr++) {
-        js_group = cJSON_CreateObject();
-        cJSON_AddStringToObject(js_group, "label", gr->label);
-        cJSON_AddStringToObject(js_group, "id", gr->id);
-        js_settings = cJSON_CreateArray();
+        settings_json_begin_object(js, NULL);
+        settings_json_add_string(js, "label", gr->label);
+        settings_json_add_string(js, "id", gr->id);
+        settings_json_begin_array(js, "settings");
         for (setting_t *setting = gr->settings; setting->label; setting++) {
-            js_setting = cJSON_CreateObject();
-            cJSON_AddStringToObject(js_setting, "label", setting->label);
-            cJSON_AddStringToObject(js_setting, "id", setting->id);
-            cJSON_AddStringToObject(js_setting, "type", types[setting->type]);
+            settings_json_begin_object(js, NULL);
+            settings_json_add_string(js, "label", setting->label);
+            settings_json_add_string(js, "id", setting->id);
+            settings_json_add_string(js, "type", types[setting->type]);
             switch (setting->type) {
             case SETTING_TYPE_BOOL:
-                cJSON_AddBoolToObject(js_setting, "val", setting->boolean.val);
-                cJSON_AddBoolToObject(js_setting, "def", setting->boolean.def);
+                if (values)
+                    settings_json_add_bool(js, "val", setting->boolean.val);
+                settings_json_add_bool(js, "def", setting->boolean.def);
                 break;
             case SETTING_TYPE_NUM:
-                cJSON_AddNumberToObject(js_setting, "val", setting->num.val);
-                cJSON_AddNumberToObject(js_setting, "def", setting->num.def);
-                cJSON_AddNumberToObject(js_setting, "min", setting->num.range[0]);
-                cJSON_AddNumberToObject(js_setting, "max", setting->num.range[1]);
+                if (values)
+                    settings_json_add_number(js, "val", setting->num.val);
+                settings_json_add_number(js, "def", setting->num.def);
+                settings_json_add_number(js, "min", setting->num.range[0]);
+                settings_json_add_number(js, "max", setting->num.range[1]);
                 break;
             case SETTING_TYPE_ONEOF:
-                cJSON_AddNumberToObject(js_setting, "val", setting->oneof.val);
-                cJSON_AddNumberToObject(js_setting, "def", setting->oneof.def);
-                js_labels = cJSON_CreateArray();
-                cJSON_AddItemToObject(js_setting, "options", js_labels);
+                if (values)
+                    settings_json_add_number(js, "val", setting->oneof.val);
+                settings_json_add_number(js, "def", setting->oneof.def);
+                settings_json_begin_array(js, "options");
                 for (const char **opt = setting->oneof.options; *opt != NULL; opt++)
-                    cJSON_AddItemToArray(js_labels, cJSON_CreateString(*opt));
+                    settings_json_add_string(js, NULL, *opt);
+                settings_json_end_array(js);
                 break;
             case SETTING_TYPE_TEXT:
-                cJSON_AddStringToObject(js_setting, "val", setting->text.val);
-                cJSON_AddStringToObject(js_setting, "def", setting->text.def);
-                cJSON_AddNumberToObject(js_setting, "len", setting->text.len);
+                if (values)
+                    settings_json_add_string(js, "val", setting->text.val);
+                settings_json_add_string(js, "def", setting->text.def);
+                settings_json_add_number(js, "len", setting->text.len);
                 break;
 #ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
             case SETTING_TYPE_TIME:
-                cJSON_AddNumberToObject(js_setting, "hh", setting->time.hh);
-                cJSON_AddNumberToObject(js_setting, "mm", setting->time.mm);
+                if (!values)
+                    break;
+                settings_json_add_number(js, "hh", setting->time.hh);
+                settings_json_add_number(js, "mm", setting->time.mm);
                 break;
             case SETTING_TYPE_DATE:
-                cJSON_AddNumberToObject(js_setting, "day", setting->date.day);
-                cJSON_AddNumberToObject(js_setting, "month", setting->date.month);
-                cJSON_AddNumberToObject(js_setting, "year", setting->date.year);
+                if (!values)
+                    break;
+                settings_json_add_number(js, "day", setting->date.day);
+                settings_json_add_number(js, "month", setting->date.month);
+                settings_json_add_number(js, "year", setting->date.year);
                 break;
             case SETTING_TYPE_DATETIME:
+                if (!values)
+                    break;
                 datetime_gettimeofday(&setting->datetime);
-                cJSON_AddNumberToObject(js_setting, "hh", setting->datetime.time.hh);
-                cJSON_AddNumberToObject(js_setting, "mm", setting->datetime.time.mm);
-                cJSON_AddNumberToObject(js_setting, "day", setting->datetime.date.day);
-                cJSON_AddNumberToObject(js_setting, "month", setting->datetime.date.month);
-                cJSON_AddNumberToObject(js_setting, "year", setting->datetime.date.year);
+                settings_json_add_number(js, "hh", setting->datetime.time.hh);
+                settings_json_add_number(js, "mm", setting->datetime.time.mm);
+                settings_json_add_number(js, "day", setting->datetime.date.day);
+                settings_json_add_number(js, "month", setting->datetime.date.month);
+                settings_json_add_number(js, "year", setting->datetime.date.year);
                 break;
 #endif
 #ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
             case SETTING_TYPE_TIMEZONE:
-                cJSON_AddStringToObject(js_setting, "val", setting->timezone.val);
-                cJSON_AddStringToObject(js_setting, "def", setting->timezone.def);
-                cJSON_AddNumberToObject(js_setting, "len", setting->timezone.len);
+                if (values)
+                    settings_json_add_string(js, "val", setting->timezone.val);
+                settings_json_add_string(js, "def", setting->timezone.def);
+                settings_json_add_number(js, "len", setting->timezone.len);
                 break;
 #endif
 #ifdef CONFIG_SETTINGS_COLOR_SUPPORT
             case SETTING_TYPE_COLOR: {
                 char buf[8];
+
+                if (!values)
+                    break;
                 snprintf(buf, sizeof(buf), "#%02x%02x%02x", setting->color.r, setting->color.g, setting->color.b);
-                cJSON_AddStringToObject(js_setting, "val", buf);
+                settings_json_add_string(js, "val", buf);
             } break;
 #endif
             default:
                 break;
             }
-            cJSON_AddItemToArray(js_settings, js_setting);
+            settings_json_end_object(js);
         }
-        cJSON_AddItemToObject(js_group, "settings", js_settings);
-        cJSON_AddItemToArray(js_groups, js_group);
+        settings_json_end_array(js);
+        settings_json_end_object(js);
     }
-    js = cJSON_CreateObject();
-    cJSON_AddItemToObject(js, "groups", js_groups);
-    return js;
+    settings_json_end_array(js);
+    settings_json_end_object(js);
 }
 
-static esp_err_t set_req_handle(httpd_req_t *req)
+// apply a value submitted by the settings form
+static void setting_set_from_form(setting_t *setting, const char *value)
+{
+    setting_t prev;
+
+    memcpy(&prev, setting, sizeof(prev));
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL: {
+        setting->boolean.val = !strcmp("on", value);
+    } break;
+    case SETTING_TYPE_NUM: {
+        int num_val = atoi(value);
+        if (num_val >= setting->num.range[0] && num_val <= setting->num.range[1])
+            setting->num.val = atoi(value);
+    } break;
+    case SETTING_TYPE_ONEOF: {
+        int num_val = atoi(value);
+        int labels_count = 0;
+        for (const char **label = setting->oneof.options; *label != NULL; label++)
+            labels_count++;
+        if (num_val < labels_count)
+            setting->oneof.val = atoi(value);
+    } break;
+    case SETTING_TYPE_TEXT: {
+        setting_text_update(setting, &setting->text, value);
+    } break;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        sscanf(value, "%d:%d", &setting->time.hh, &setting->time.mm);
+    } break;
+    case SETTING_TYPE_DATE: {
+        sscanf(value, "%d-%d-%d", &setting->date.year, &setting->date.month, &setting->date.day);
+    } break;
+    case SETTING_TYPE_DATETIME: {
+        sscanf(value, "%d-%d-%dT%d:%d", &setting->datetime.date.year, &setting->datetime.date.month,
+               &setting->datetime.date.day, &setting->datetime.time.hh, &setting->datetime.time.mm);
+        /* the clock runs on, so a submitted date and time is always applied */
+        setting_mark_changed(setting);
+    } break;
+#endif
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE: {
+        setting_text_update(setting, &setting->timezone, value);
+    } break;
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR: {
+        setting->color.combined = strtol(value + 1, NULL, 16);
+    } break;
+#endif
+    default:
+        break;
+    }
+    if (memcmp(&prev, setting, sizeof(prev)))
+        setting_mark_changed(setting);
+}
+
+typedef struct {
+    const settings_index_t *idx;
+    uint8_t                *seen; /* one bit per index entry */
+} set_req_ctx_t;
+
+static void set_req_field(const char *key, const char *value, void *arg)
 {
-    char *req_data;
-    char  srch_id[128];
-    char  value[128];
-    int   bytes_recv = 0;
-    int   rc;
+    set_req_ctx_t          *ctx = arg;
+    const settings_entry_t *e = settings_index_lookup_key(ctx->idx, key);
+    size_t                  n;
+
+    if (!e)
+        return;
+
+    n = e - ctx->idx->entries;
+    ctx->seen[n / 8] |= 1 << (n % 8);
+    setting_set_from_form(e->setting, value);
+}
 
+static esp_err_t set_req_handle(httpd_req_t *req)
+{
     settings_group_t *settings_pack = req->user_ctx;
+    set_req_ctx_t     ctx;
+    int               rc;
+
     if (req->content_len) {
-        req_data = calloc(1, req->content_len + 1);
-        if (!req_data)
+        rc = settings_pack_index(settings_pack);
+        if (rc != ESP_OK)
+            return rc;
+
+        ctx.idx = settings_index_get(settings_pack);
+        ctx.seen = calloc(1, (ctx.idx->count + 7) / 8);
+        if (!ctx.seen)
             return ESP_ERR_NO_MEM;
 
-        for (int bytes_left = req->content_len; bytes_left > 0;) {
-            if ((rc = httpd_req_recv(req, req_data + bytes_recv, bytes_left)) <= 0) {
-                if (rc == HTTPD_SOCK_ERR_TIMEOUT)
-                    continue;
-                else
-                    return ESP_FAIL;
-            }
-            bytes_recv += rc;
-            bytes_left -= rc;
+        rc = settings_form_parse(req, set_req_field, &ctx);
+        if (rc != ESP_OK) {
+            free(ctx.seen);
+            return rc;
         }
 
-        for (settings_group_t *gr = settings_pack; gr->label; gr++) {
-            for (setting_t *setting = gr->settings; setting->label; setting++) {
-                sprintf(srch_id, "%s:%s", gr->id, setting->id);
-                if (httpd_query_key_value(req_data, srch_id, value, sizeof(value)) != ESP_OK) {
-                    if (setting->type == SETTING_TYPE_BOOL)
-                        setting->boolean.val = false;
-                    continue;
-                }
+        // unchecked checkboxes are not submitted at all
+        for (size_t i = 0; i < ctx.idx->count; i++) {
+            setting_t *setting = ctx.idx->entries[i].setting;
 
-                switch (setting->type) {
-                case SETTING_TYPE_BOOL: {
-                    setting->boolean.val = !strcmp("on", value);
-                } break;
-                case SETTING_TYPE_NUM: {
-                    int num_val = atoi(value);
-                    if (num_val >= setting->num.range[0] && num_val <= setting->num.range[1])
-                        setting->num.val = atoi(value);
-                } break;
-                case SETTING_TYPE_ONEOF: {
-                    int num_val = atoi(value);
-                    int labels_count = 0;
-                    for (const char **label = setting->oneof.options; *label != NULL; label++)
-                        labels_count++;
-                    if (num_val < labels_count)
-                        setting->oneof.val = atoi(value);
-                } break;
-                case SETTING_TYPE_TEXT: {
-                    strncpy(setting->text.val, value, setting->text.len);
-                } break;
-#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
-                case SETTING_TYPE_TIME: {
-                    sscanf(value, "%d:%d", &setting->time.hh, &setting->time.mm);
-                } break;
-                case SETTING_TYPE_DATE: {
-                    sscanf(value, "%d-%d-%d", &setting->date.year, &setting->date.month, &setting->date.day);
-                } break;
-                case SETTING_TYPE_DATETIME: {
-                    sscanf(value, "%d-%d-%dT%d:%d", &setting->datetime.date.year, &setting->datetime.date.month,
-                           &setting->datetime.date.day, &setting->datetime.time.hh, &setting->datetime.time.mm);
-
-                } break;
-#endif
-#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
-                case SETTING_TYPE_TIMEZONE: {
-                    strncpy(setting->timezone.val, value, setting->timezone.len);
-                } break;
-#endif
-#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
-                case SETTING_TYPE_COLOR: {
-                    setting->color.combined = strtol(value + 1, NULL, 16);
-                } break;
-#endif
-                default:
-                    break;
-                }
+            if (setting->type == SETTING_TYPE_BOOL && !(ctx.seen[i / 8] & (1 << (i % 8))) && setting->label &&
+                setting->boolean.val) {
+                setting->boolean.val = false;
+                setting_mark_changed(setting);
             }
         }
-        free(req_data);
+        free(ctx.seen);
     }
 
     rc = settings_nvs_write(settings_pack);
     if (rc == 0) {
         ESP_LOGI(TAG, "nvs write OK");
-        if (settings_handler != NULL)
-            settings_handler(settings_pack, handler_arg);
+        settings_changed(settings_pack);
         return ESP_OK;
     } else {
         ESP_LOGE(TAG, "nvs write ERR:%s(%d)", esp_err_to_name(rc), rc);
@@ -552,16 +862,568 @@ static esp_err_t set_req_handle(httpd_req_t *req)
     }
 }
 
-esp_err_t settings_httpd_handler(httpd_req_t *req)
+/*
+ * JSON patch: {"GROUP:ID": value, ...} with the values in the same notation
+ * as the form, e.g. true, 42, "text", "07:30", "2025-04-03", "#ff8000".
+ * All values are checked before any is applied.
+ */
+typedef struct {
+    const char             *key;
+    const settings_group_t *group;
+    setting_t              *setting;
+    setting_t               staged;
+    setting_t               prev;      /* value before the patch, restored if it cannot be stored */
+    const char             *text;      /* new TEXT/TIMEZONE value, owned by the parsed request */
+    char                   *prev_text; /* copy of the previous TEXT/TIMEZONE value */
+    bool                    changed;
+} patch_item_t;
+
+static bool patch_int(const cJSON *val, int min, int max, int *out)
+{
+    if (!cJSON_IsNumber(val) || val->valuedouble != (double)val->valueint)
+        return false;
+    if (val->valueint < min || val->valueint > max)
+        return false;
+    *out = val->valueint;
+    return true;
+}
+
+// check a patch value against the setting schema and stage it
+static bool setting_patch_value(patch_item_t *item, const cJSON *val)
+{
+    setting_t  *staged = &item->staged;
+    const char *str = cJSON_IsString(val) ? val->valuestring : NULL;
+
+    switch (staged->type) {
+    case SETTING_TYPE_BOOL:
+        if (!cJSON_IsBool(val))
+            return false;
+        staged->boolean.val = cJSON_IsTrue(val);
+        return true;
+    case SETTING_TYPE_NUM:
+        return patch_int(val, staged->num.range[0], staged->num.range[1], &staged->num.val);
+    case SETTING_TYPE_ONEOF: {
+        int labels_count = 0;
+        for (const char **label = staged->oneof.options; *label != NULL; label++)
+            labels_count++;
+        return patch_int(val, 0, labels_count - 1, &staged->oneof.val);
+    }
+    case SETTING_TYPE_TEXT:
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE:
+#endif
+        // TEXT and TIMEZONE share the setting_text_t layout
+        if (!str || strlen(str) >= staged->text.len)
+            return false;
+        item->text = str;
+        return true;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        setting_time_t t;
+        if (!str || sscanf(str, "%d:%d", &t.hh, &t.mm) != 2 || t.hh < 0 || t.hh > 23 || t.mm < 0 || t.mm > 59)
+            return false;
+        staged->time = t;
+        return true;
+    }
+    case SETTING_TYPE_DATE: {
+        setting_date_t d;
+        if (!str || sscanf(str, "%d-%d-%d", &d.year, &d.month, &d.day) != 3 || d.month < 1 || d.month > 12 ||
+            d.day < 1 || d.day > 31)
+            return false;
+        staged->date = d;
+        return true;
+    }
+    case SETTING_TYPE_DATETIME: {
+        setting_datetime_t dt;
+        if (!str || sscanf(str, "%d-%d-%dT%d:%d", &dt.date.year, &dt.date.month, &dt.date.day, &dt.time.hh,
+                           &dt.time.mm) != 5)
+            return false;
+        if (dt.date.month < 1 || dt.date.month > 12 || dt.date.day < 1 || dt.date.day > 31 || dt.time.hh < 0 ||
+            dt.time.hh > 23 || dt.time.mm < 0 || dt.time.mm > 59)
+            return false;
+        staged->datetime = dt;
+        return true;
+    }
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR: {
+        unsigned int rgb;
+        if (!str || strlen(str) != 7 || sscanf(str, "#%6x", &rgb) != 1)
+            return false;
+        staged->color.combined = rgb;
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+// value of a setting in patch notation
+static void setting_value_to_json(settings_json_t *js, const char *key, const setting_t *setting)
+{
+    char buf[24];
+
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL:
+        settings_json_add_bool(js, key, setting->boolean.val);
+        break;
+    case SETTING_TYPE_NUM:
+        settings_json_add_number(js, key, setting->num.val);
+        break;
+    case SETTING_TYPE_ONEOF:
+        settings_json_add_number(js, key, setting->oneof.val);
+        break;
+    case SETTING_TYPE_TEXT:
+        settings_json_add_string(js, key, setting->text.val);
+        break;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME:
+        snprintf(buf, sizeof(buf), "%02d:%02d", setting->time.hh, setting->time.mm);
+        settings_json_add_string(js, key, buf);
+        break;
+    case SETTING_TYPE_DATE:
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", setting->date.year, setting->date.month, setting->date.day);
+        settings_json_add_string(js, key, buf);
+        break;
+    case SETTING_TYPE_DATETIME:
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d", setting->datetime.date.year,
+                 setting->datetime.date.month, setting->datetime.date.day, setting->datetime.time.hh,
+                 setting->datetime.time.mm);
+        settings_json_add_string(js, key, buf);
+        break;
+#endif
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE:
+        settings_json_add_string(js, key, setting->timezone.val);
+        break;
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR:
+        snprintf(buf, sizeof(buf), "#%02x%02x%02x", setting->color.r, setting->color.g, setting->color.b);
+        settings_json_add_string(js, key, buf);
+        break;
+#endif
+    default:
+        settings_json_add_string(js, key, NULL);
+        break;
+    }
+}
+
+// apply a staged value, returns true if the setting changed
+static bool patch_item_apply(patch_item_t *item)
+{
+    setting_t *setting = item->setting;
+    bool       was_dirty = setting->dirty;
+    bool       changed;
+
+    setting->dirty = false;
+    item->staged.dirty = false;
+    if (item->text) {
+        setting_text_update(setting, &setting->text, item->text);
+    } else if (memcmp(&item->staged, setting, sizeof(*setting))) {
+        memcpy(setting, &item->staged, sizeof(*setting));
+        setting_mark_changed(setting);
+    }
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    /* the clock runs on, so a submitted date and time is always applied */
+    if (setting->type == SETTING_TYPE_DATETIME)
+        setting_mark_changed(setting);
+#endif
+    changed = setting->dirty;
+    setting->dirty |= was_dirty;
+    return changed;
+}
+
+// keep the current value, so the patch can be undone
+static bool patch_item_save(patch_item_t *item)
+{
+    memcpy(&item->prev, item->setting, sizeof(setting_t));
+    if (item->text) {
+        item->prev_text = strdup(item->setting->text.val);
+        return item->prev_text != NULL;
+    }
+    return true;
+}
+
+// undo all items, in reverse order in case a setting was patched twice
+static void patch_items_restore(patch_item_t *items, size_t count)
+{
+    for (size_t i = count; i--;) {
+        memcpy(items[i].setting, &items[i].prev, sizeof(setting_t));
+        if (items[i].prev_text)
+            strcpy(items[i].setting->text.val, items[i].prev_text);
+    }
+}
+
+#ifdef CONFIG_SETTINGS_STORAGE_BLOB
+// a group is one blob: store it once, for the first changed item in it
+static bool patch_item_stored(const patch_item_t *items, size_t i)
+{
+    for (size_t j = 0; j < i; j++) {
+        if (items[j].changed && items[j].group == items[i].group)
+            return true;
+    }
+    return false;
+}
+
+static esp_err_t patch_item_store(nvs_handle nvs, const patch_item_t *item)
+{
+    return settings_group_write(nvs, item->group);
+}
+#else
+static bool patch_item_stored(const patch_item_t *items, size_t i)
+{
+    return false;
+}
+
+static esp_err_t patch_item_store(nvs_handle nvs, const patch_item_t *item)
+{
+    char nvs_id[128];
+
+    snprintf(nvs_id, sizeof(nvs_id), "%s:%s", item->group->id, item->setting->id);
+    if (strnlen(nvs_id, sizeof(nvs_id)) >= NVS_KEY_NAME_MAX_SIZE - 1) {
+        ESP_LOGE(TAG, "NVS key too long: %s", nvs_id);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return setting_nvs_set(nvs, nvs_id, item->setting);
+}
+#endif
+
+/*
+ * Store the settings changed by a patch and no others. If any of them cannot
+ * be stored the whole patch is undone: the previous values are put back in RAM
+ * and rewritten to the entries already stored.
+ */
+static esp_err_t patch_items_write(patch_item_t *items, size_t count)
+{
+    nvs_handle nvs;
+    size_t     done;
+    esp_err_t  rc;
+
+    rc = nvs_open(NVS_STORAGE, NVS_READWRITE, &nvs);
+    if (rc != ESP_OK) {
+        ESP_LOGE(TAG, "nvs open error %s", esp_err_to_name(rc));
+        patch_items_restore(items, count);
+        return rc;
+    }
+
+    for (done = 0; done < count; done++) {
+        if (!items[done].changed || patch_item_stored(items, done))
+            continue;
+        rc = patch_item_store(nvs, &items[done]);
+        if (rc != ESP_OK)
+            break;
+    }
+    if (rc == ESP_OK)
+        rc = nvs_commit(nvs);
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    /* the clock cannot be rolled back, so it is set once everything else is stored */
+    for (size_t i = 0; rc == ESP_OK && i < count; i++) {
+        if (items[i].changed && items[i].setting->type == SETTING_TYPE_DATETIME &&
+            datetime_settimeofday(&items[i].setting->datetime))
+            rc = ESP_FAIL;
+    }
+#endif
+
+    if (rc == ESP_OK) {
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].changed)
+                items[i].setting->dirty = false;
+        }
+    } else {
+        ESP_LOGE(TAG, "patch not stored: %s, rolling back", esp_err_to_name(rc));
+        patch_items_restore(items, count);
+        for (size_t i = 0; i < done; i++) {
+            if (items[i].changed && !patch_item_stored(items, i))
+                patch_item_store(nvs, &items[i]);
+        }
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return rc;
+}
+
+static esp_err_t patch_req_handle(httpd_req_t *req)
+{
+    settings_group_t       *settings_pack = req->user_ctx;
+    const settings_index_t *idx;
+    patch_item_t           *items = NULL;
+    cJSON                  *root = NULL;
+    settings_json_t         js;
+    char                   *body;
+    char                    msg[96];
+    size_t                  count = 0;
+    bool                    changed = false;
+    int                     rc;
+
+    if (!req->content_len || req->content_len > PATCH_MAX_LEN)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad patch size");
+
+    rc = settings_pack_index(settings_pack);
+    if (rc != ESP_OK)
+        return rc;
+    idx = settings_index_get(settings_pack);
+
+    body = malloc(req->content_len + 1);
+    if (!body)
+        return ESP_ERR_NO_MEM;
+    for (size_t bytes_recv = 0; bytes_recv < req->content_len;) {
+        if ((rc = httpd_req_recv(req, body + bytes_recv, req->content_len - bytes_recv)) <= 0) {
+            if (rc == HTTPD_SOCK_ERR_TIMEOUT)
+                continue;
+            free(body);
+            return ESP_FAIL;
+        }
+        bytes_recv += rc;
+    }
+    body[req->content_len] = '\0';
+    root = cJSON_Parse(body);
+    free(body);
+
+    if (!cJSON_IsObject(root)) {
+        rc = httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "patch is not a JSON object");
+        goto out;
+    }
+
+    items = calloc(cJSON_GetArraySize(root) + 1, sizeof(*items));
+    if (!items) {
+        rc = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    for (const cJSON *val = root->child; val; val = val->next, count++) {
+        const settings_entry_t *e = settings_index_lookup_key(idx, val->string);
+
+        if (!e || e->setting->disabled) {
+            snprintf(msg, sizeof(msg), "%s setting %s", e ? "read-only" : "unknown", val->string);
+            rc = httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+            goto out;
+        }
+        items[count].key = val->string;
+        items[count].group = e->group;
+        items[count].setting = e->setting;
+        memcpy(&items[count].staged, e->setting, sizeof(setting_t));
+        if (!setting_patch_value(&items[count], val)) {
+            snprintf(msg, sizeof(msg), "invalid value for %s", val->string);
+            rc = httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+            goto out;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!patch_item_save(&items[i])) {
+            rc = ESP_ERR_NO_MEM;
+            goto out;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        items[i].changed = patch_item_apply(&items[i]);
+        changed |= items[i].changed;
+    }
+
+    if (changed) {
+        rc = patch_items_write(items, count);
+        if (rc != ESP_OK) {
+            ESP_LOGE(TAG, "nvs write ERR:%s(%d)", esp_err_to_name(rc), rc);
+            rc = httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "nvs write failed");
+            goto out;
+        }
+        settings_changed(settings_pack);
+    }
+
+    // reply with the settings that actually changed
+    settings_json_init(&js, req);
+    settings_json_begin_object(&js, NULL);
+    settings_json_begin_object(&js, "data");
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].changed)
+            setting_value_to_json(&js, items[i].key, items[i].setting);
+    }
+    settings_json_end_object(&js);
+    settings_json_end_object(&js);
+    rc = settings_json_finish(&js);
+
+out:
+    cJSON_Delete(root);
+    for (size_t i = 0; items && i < count; i++)
+        free(items[i].prev_text);
+    free(items);
+    return rc;
+}
+
+static uint32_t settings_boot_id(void)
 {
-    cJSON *js;
-    char  *url_query;
-    size_t qlen;
-    char   value[128];
+    if (!boot_id)
+        boot_id = esp_random() | 1;
+    return boot_id;
+}
 
-    js = cJSON_CreateObject();
+// "<boot>-<gen>": names the current settings state, unique across reboots
+static void settings_gen_token(char *buf, size_t len)
+{
+    snprintf(buf, len, "%08" PRIx32 "-%" PRIu32, settings_boot_id(), generation);
+}
+
+// current ETag, it changes with every settings change and on every boot
+static void settings_etag(char *buf, size_t len)
+{
+    char token[20];
+
+    settings_gen_token(token, sizeof(token));
+    snprintf(buf, len, "\"%s\"", token);
+}
 
+// generation of a `since` token, 0 (send everything) if it is from another boot
+static uint32_t settings_since(const char *token)
+{
+    char    *end;
+    uint32_t boot = strtoul(token, &end, 16);
+    uint32_t since;
+
+    if (*end != '-' || boot != settings_boot_id())
+        return 0;
+    since = strtoul(end + 1, NULL, 10);
+    return since > generation ? 0 : since;
+}
+
+static bool settings_etag_match(httpd_req_t *req, const char *etag)
+{
+    char   buf[96];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+
+    if (!len || len >= sizeof(buf))
+        return false;
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", buf, sizeof(buf)) != ESP_OK)
+        return false;
+    return !strcmp(buf, "*") || strstr(buf, etag);
+}
+
+// hash of the schema JSON, computed once per pack
+static uint32_t settings_schema_hash(settings_group_t *settings_pack)
+{
+    static const settings_group_t *hashed;
+    static uint32_t                hash;
+    settings_json_t                js;
+
+    if (hashed != settings_pack) {
+        settings_json_init(&js, NULL);
+        settings_pack_to_json(&js, NULL, settings_pack, false);
+        settings_json_finish(&js);
+        hashed = settings_pack;
+        hash = js.hash;
+    }
+    return hash;
+}
+
+// values of the settings changed after generation `since`
+static void settings_values_to_json(settings_json_t *js, settings_group_t *settings_pack, uint32_t since)
+{
+    char key[64];
+
+    settings_json_begin_object(js, NULL);
+    settings_gen_token(key, sizeof(key));
+    settings_json_add_string(js, "gen", key);
+    snprintf(key, sizeof(key), "%08" PRIx32, settings_schema_hash(settings_pack));
+    settings_json_add_string(js, "schema", key);
+    settings_json_begin_object(js, "data");
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++) {
+            if (setting->gen <= since)
+                continue;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+            if (setting->type == SETTING_TYPE_DATETIME)
+                datetime_gettimeofday(&setting->datetime);
+#endif
+            snprintf(key, sizeof(key), "%s:%s", gr->id, setting->id);
+            setting_value_to_json(js, key, setting);
+        }
+    }
+    settings_json_end_object(js);
+    settings_json_end_object(js);
+}
+
+/*
+ * Answer a conditional GET with 304 Not Modified if `etag` matches,
+ * otherwise set the ETag of the response. Returns true if it was answered.
+ */
+static bool settings_not_modified(httpd_req_t *req, const char *etag, esp_err_t *rc)
+{
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (!settings_etag_match(req, etag))
+        return false;
+    httpd_resp_set_status(req, "304 Not Modified");
+    *rc = httpd_resp_send(req, NULL, 0);
+    return true;
+}
+
+esp_err_t settings_schema_httpd_handler(httpd_req_t *req)
+{
+    settings_json_t   js;
     settings_group_t *settings_pack = req->user_ctx;
+    char              hash[12];
+    char              etag[16];
+    char              query[32];
+    char              value[12];
+    esp_err_t         rc;
+
+    snprintf(hash, sizeof(hash), "%08" PRIx32, settings_schema_hash(settings_pack));
+    snprintf(etag, sizeof(etag), "\"%s\"", hash);
+
+    // "?h=<hash>" names one version of the schema, so it can be cached for good
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "h", value, sizeof(value)) == ESP_OK && !strcmp(value, hash))
+        httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=31536000, immutable");
+    else
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if (settings_not_modified(req, etag, &rc))
+        return rc;
+
+    settings_json_init(&js, req);
+    settings_pack_to_json(&js, NULL, settings_pack, false);
+    return settings_json_finish(&js);
+}
+
+esp_err_t settings_values_httpd_handler(httpd_req_t *req)
+{
+    settings_json_t   js;
+    settings_group_t *settings_pack = req->user_ctx;
+    char              etag[24];
+    char              query[48];
+    char              value[24];
+    uint32_t          since = 0;
+    esp_err_t         rc;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK)
+        since = settings_since(value);
+
+    // the header value is only copied when the response is sent
+    settings_etag(etag, sizeof(etag));
+    if (settings_not_modified(req, etag, &rc))
+        return rc;
+
+    settings_json_init(&js, req);
+    settings_values_to_json(&js, settings_pack, since);
+    return settings_json_finish(&js);
+}
+
+esp_err_t settings_httpd_handler(httpd_req_t *req)
+{
+    settings_json_t js;
+    char           *url_query;
+    size_t          qlen;
+    char            value[128];
+    char            etag[24];
+    bool            conditional = true;
+    bool            changes = false;
+    uint32_t        since = 0;
+    esp_err_t       rc;
+
+    settings_group_t *settings_pack = req->user_ctx;
+
+    if (req->method == HTTP_PATCH)
+        return patch_req_handle(req);
 
     //parse URL query
     qlen = httpd_req_get_url_query_len(req) + 1;
@@ -569,20 +1431,46 @@ esp_err_t settings_httpd_handler(httpd_req_t *req)
         url_query = malloc(qlen);
         if (httpd_req_get_url_query_str(req, url_query, qlen) == ESP_OK) {
             if (httpd_query_key_value(url_query, "action", value, sizeof(value)) == ESP_OK) {
+                conditional = false;
                 if (!strcmp(value, "set")) {
                     set_req_handle(req);
+                } else if (!strcmp(value, "patch")) {
+                    free(url_query);
+                    return patch_req_handle(req);
                 } else if (!strcmp(value, "erase")) {
-                    settings_pack_set_defaults(settings_pack);
                     settings_nvs_erase(settings_pack);
                 } else if (!strcmp(value, "restart")) {
-                    send_json_response(js, req);
+                    settings_json_init(&js, req);
+                    settings_json_begin_object(&js, NULL);
+                    settings_json_end_object(&js);
+                    settings_json_finish(&js);
                     esp_restart();
                     return ESP_OK;
                 }
+            } else if (httpd_query_key_value(url_query, "since", value, sizeof(value)) == ESP_OK) {
+                since = settings_since(value);
+                changes = true;
             }
         }
         free(url_query);
     }
-    cJSON_AddItemToObject(js, "data", settings_pack_to_json(settings_pack));
-    return send_json_response(js, req);
+
+    // the header value is only copied when the response is sent
+    settings_etag(etag, sizeof(etag));
+    if (conditional) {
+        if (settings_not_modified(req, etag, &rc))
+            return rc;
+    } else {
+        httpd_resp_set_hdr(req, "ETag", etag);
+    }
+
+    settings_json_init(&js, req);
+    if (changes) {
+        settings_values_to_json(&js, settings_pack, since);
+    } else {
+        settings_json_begin_object(&js, NULL);
+        settings_pack_to_json(&js, "data", settings_pack, true);
+        settings_json_end_object(&js);
+    }
+    return settings_json_finish(&js);
 }
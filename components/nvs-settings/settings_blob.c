@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "settings_priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define REC_HDR_LEN 3 /* id length (u8) + value length (u16) */
+
+// text buffer of TEXT and TIMEZONE settings, NULL for other types
+static const setting_text_t *setting_blob_text(const setting_t *setting)
+{
+    switch (setting->type) {
+    case SETTING_TYPE_TEXT:
+        return &setting->text;
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE:
+        return &setting->timezone;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+// serialize a value in the same widths as the per-key layout, returns its length
+static size_t setting_blob_encode(const setting_t *setting, uint8_t *out)
+{
+    const setting_text_t *text = setting_blob_text(setting);
+    uint8_t               u8;
+    int32_t               i32;
+    uint32_t              u32;
+
+    if (text) {
+        size_t len = strnlen(text->val, text->len);
+        if (out)
+            memcpy(out, text->val, len);
+        return len;
+    }
+
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL:
+        u8 = setting->boolean.val;
+        break;
+    case SETTING_TYPE_ONEOF:
+        u8 = setting->oneof.val;
+        break;
+    case SETTING_TYPE_NUM:
+        i32 = setting->num.val;
+        if (out)
+            memcpy(out, &i32, sizeof(i32));
+        return sizeof(i32);
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        uint16_t u16 = (setting->time.hh << 8) | setting->time.mm;
+        if (out)
+            memcpy(out, &u16, sizeof(u16));
+        return sizeof(u16);
+    }
+    case SETTING_TYPE_DATE:
+        u32 = ((uint32_t)(setting->date.day & 0xFF) << 24) | ((uint32_t)(setting->date.month & 0xFF) << 16) |
+              ((uint32_t)(setting->date.year & 0xFFFF));
+        if (out)
+            memcpy(out, &u32, sizeof(u32));
+        return sizeof(u32);
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR:
+        u32 = setting->color.combined;
+        if (out)
+            memcpy(out, &u32, sizeof(u32));
+        return sizeof(u32);
+#endif
+    default:
+        /* DATETIME is not stored */
+        return 0;
+    }
+    if (out)
+        *out = u8;
+    return sizeof(u8);
+}
+
+static void setting_blob_decode(setting_t *setting, const uint8_t *in, size_t len)
+{
+    const setting_text_t *text = setting_blob_text(setting);
+    uint32_t              u32;
+    int32_t               i32;
+
+    if (text) {
+        if (len >= text->len)
+            len = text->len - 1;
+        memcpy(text->val, in, len);
+        text->val[len] = '\0';
+        return;
+    }
+
+    if (len != setting_blob_encode(setting, NULL))
+        return;
+
+    switch (setting->type) {
+    case SETTING_TYPE_BOOL:
+        setting->boolean.val = *in;
+        break;
+    case SETTING_TYPE_ONEOF:
+        setting->oneof.val = (int8_t)*in;
+        break;
+    case SETTING_TYPE_NUM:
+        memcpy(&i32, in, sizeof(i32));
+        setting->num.val = i32;
+        break;
+#ifdef CONFIG_SETTINGS_DATETIME_SUPPORT
+    case SETTING_TYPE_TIME: {
+        uint16_t u16;
+        memcpy(&u16, in, sizeof(u16));
+        setting->time.hh = (u16 >> 8);
+        setting->time.mm = (u16 & 0xFF);
+    } break;
+    case SETTING_TYPE_DATE:
+        memcpy(&u32, in, sizeof(u32));
+        setting->date.day = (u32 >> 24 & 0xFF);
+        setting->date.month = (u32 >> 16 & 0xFF);
+        setting->date.year = (u32 & 0xFFFF);
+        break;
+#endif
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    case SETTING_TYPE_COLOR:
+        memcpy(&u32, in, sizeof(u32));
+        setting->color.combined = u32;
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+// blob size for the current values, or the largest one the group can produce
+static size_t settings_blob_size(const settings_group_t *gr, bool max)
+{
+    size_t size = sizeof(settings_blob_hdr_t);
+
+    for (const setting_t *setting = gr->settings; setting->id; setting++) {
+        const setting_text_t *text = setting_blob_text(setting);
+
+        size += REC_HDR_LEN + strlen(setting->id);
+        size += (max && text) ? text->len : setting_blob_encode(setting, NULL);
+    }
+    return size;
+}
+
+// records are usually in group order, so try the setting after the previous match first
+static setting_t *settings_blob_match(const settings_group_t *gr, setting_t **next, const uint8_t *id, size_t id_len)
+{
+    setting_t *setting = *next;
+
+    if (!setting->id || strncmp(setting->id, (const char *)id, id_len) || setting->id[id_len]) {
+        for (setting = gr->settings; setting->id; setting++) {
+            if (!strncmp(setting->id, (const char *)id, id_len) && !setting->id[id_len])
+                break;
+        }
+        if (!setting->id)
+            return NULL;
+    }
+    *next = setting + 1;
+    return setting;
+}
+
+esp_err_t settings_blob_read(nvs_handle nvs, const settings_group_t *gr)
+{
+    settings_blob_hdr_t hdr;
+    setting_t          *next = gr->settings;
+    uint8_t            *blob;
+    size_t              len;
+    size_t              pos;
+    esp_err_t           rc;
+
+    // sized for the current schema, so one NVS read is enough unless the schema shrank
+    len = settings_blob_size(gr, true);
+    blob = malloc(len);
+    if (!blob)
+        return ESP_ERR_NO_MEM;
+
+    rc = nvs_get_blob(nvs, gr->id, blob, &len);
+    if (rc == ESP_ERR_NVS_INVALID_LENGTH) {
+        uint8_t *larger;
+
+        rc = nvs_get_blob(nvs, gr->id, NULL, &len);
+        larger = rc == ESP_OK ? realloc(blob, len) : NULL;
+        if (larger) {
+            blob = larger;
+            rc = nvs_get_blob(nvs, gr->id, blob, &len);
+        } else if (rc == ESP_OK) {
+            rc = ESP_ERR_NO_MEM;
+        }
+    }
+    if (rc != ESP_OK)
+        goto out;
+
+    if (len < sizeof(hdr)) {
+        rc = ESP_ERR_INVALID_SIZE;
+        goto out;
+    }
+    memcpy(&hdr, blob, sizeof(hdr));
+    if (hdr.version != SETTINGS_BLOB_VERSION) {
+        rc = ESP_ERR_INVALID_VERSION;
+        goto out;
+    }
+
+    pos = sizeof(hdr);
+    for (unsigned i = 0; i < hdr.count; i++) {
+        setting_t *setting;
+        uint8_t    id_len;
+        uint16_t   val_len;
+
+        if (len - pos < REC_HDR_LEN) {
+            rc = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        id_len = blob[pos];
+        memcpy(&val_len, &blob[pos + 1], sizeof(val_len));
+        pos += REC_HDR_LEN;
+        if (len - pos < (size_t)id_len + val_len) {
+            rc = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        setting = settings_blob_match(gr, &next, &blob[pos], id_len);
+        if (setting)
+            setting_blob_decode(setting, &blob[pos + id_len], val_len);
+        pos += id_len + val_len;
+    }
+
+out:
+    free(blob);
+    return rc;
+}
+
+esp_err_t settings_blob_write(nvs_handle nvs, const settings_group_t *gr)
+{
+    settings_blob_hdr_t hdr = { .version = SETTINGS_BLOB_VERSION };
+    uint8_t            *blob;
+    size_t              len;
+    size_t              pos;
+    esp_err_t           rc;
+
+    len = settings_blob_size(gr, false);
+    blob = malloc(len);
+    if (!blob)
+        return ESP_ERR_NO_MEM;
+
+    pos = sizeof(hdr);
+    for (const setting_t *setting = gr->settings; setting->id; setting++) {
+        size_t   id_len = strlen(setting->id);
+        uint16_t val_len;
+
+        if (id_len > UINT8_MAX) {
+            free(blob);
+            return ESP_ERR_INVALID_ARG;
+        }
+        blob[pos] = id_len;
+        memcpy(&blob[pos + REC_HDR_LEN], setting->id, id_len);
+        val_len = setting_blob_encode(setting, &blob[pos + REC_HDR_LEN + id_len]);
+        memcpy(&blob[pos + 1], &val_len, sizeof(val_len));
+        pos += REC_HDR_LEN + id_len + val_len;
+        hdr.count++;
+    }
+    memcpy(blob, &hdr, sizeof(hdr));
+
+    rc = nvs_set_blob(nvs, gr->id, blob, pos);
+    free(blob);
+    return rc;
+}
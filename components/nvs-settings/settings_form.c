@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "settings_priv.h"
+
+#include <string.h>
+#include <esp_log.h>
+
+#define FORM_CHUNK_LEN 128 /* body bytes read per httpd_req_recv() */
+#define FORM_KEY_LEN   64
+#define FORM_VALUE_LEN 128
+
+static const char *TAG = "SETTINGS";
+
+typedef struct {
+    settings_form_cb_t cb;
+    void              *arg;
+    char               key[FORM_KEY_LEN];
+    char               value[FORM_VALUE_LEN];
+    char              *out; /* key or value being decoded */
+    size_t             len;
+    size_t             size;
+    bool               overflow;
+    char               esc[3]; /* pending %XX escape */
+    uint8_t            esc_len;
+} form_parser_t;
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static void form_put(form_parser_t *f, char c)
+{
+    if (f->len + 1 < f->size)
+        f->out[f->len++] = c;
+    else
+        f->overflow = true;
+}
+
+static void form_target(form_parser_t *f, char *out, size_t size)
+{
+    f->out = out;
+    f->size = size;
+    f->len = 0;
+}
+
+// an incomplete or invalid escape is kept as it was
+static void form_flush_escape(form_parser_t *f)
+{
+    for (uint8_t i = 0; i < f->esc_len; i++)
+        form_put(f, f->esc[i]);
+    f->esc_len = 0;
+}
+
+static void form_pair_end(form_parser_t *f)
+{
+    form_flush_escape(f);
+    f->out[f->len] = '\0';
+    if (f->out == f->key)
+        f->value[0] = '\0';
+
+    if (f->overflow)
+        ESP_LOGW(TAG, "form field %.16s... too long, skipped", f->key);
+    else if (f->key[0])
+        f->cb(f->key, f->value, f->arg);
+
+    f->overflow = false;
+    form_target(f, f->key, sizeof(f->key));
+}
+
+static void form_feed(form_parser_t *f, char c)
+{
+    if (f->esc_len) {
+        if (hex_digit(c) >= 0) {
+            f->esc[f->esc_len++] = c;
+            if (f->esc_len == 3) {
+                form_put(f, hex_digit(f->esc[1]) << 4 | hex_digit(f->esc[2]));
+                f->esc_len = 0;
+            }
+            return;
+        }
+        form_flush_escape(f);
+    }
+
+    switch (c) {
+    case '&':
+        form_pair_end(f);
+        break;
+    case '=':
+        if (f->out == f->key) {
+            f->key[f->len] = '\0';
+            form_target(f, f->value, sizeof(f->value));
+        } else {
+            form_put(f, c);
+        }
+        break;
+    case '+':
+        form_put(f, ' ');
+        break;
+    case '%':
+        f->esc[f->esc_len++] = c;
+        break;
+    default:
+        form_put(f, c);
+        break;
+    }
+}
+
+esp_err_t settings_form_parse(httpd_req_t *req, settings_form_cb_t cb, void *arg)
+{
+    form_parser_t f = { .cb = cb, .arg = arg };
+    char          chunk[FORM_CHUNK_LEN];
+
+    form_target(&f, f.key, sizeof(f.key));
+    for (size_t bytes_left = req->content_len; bytes_left > 0;) {
+        int rc = httpd_req_recv(req, chunk, bytes_left < sizeof(chunk) ? bytes_left : sizeof(chunk));
+
+        if (rc <= 0) {
+            if (rc == HTTPD_SOCK_ERR_TIMEOUT)
+                continue;
+            return ESP_FAIL;
+        }
+        for (int i = 0; i < rc; i++)
+            form_feed(&f, chunk[i]);
+        bytes_left -= rc;
+    }
+    form_pair_end(&f);
+    return ESP_OK;
+}
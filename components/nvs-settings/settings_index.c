@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "settings_priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+static const char *TAG = "SETTINGS";
+
+static settings_index_t *indexes;
+
+// FNV-1a over "gr_id:id", without building the key
+static uint32_t settings_hash(const char *gr_id, const char *id)
+{
+    uint32_t h = 2166136261u;
+
+    for (const char *p = gr_id; *p; p++)
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    h = (h ^ ':') * 16777619u;
+    for (const char *p = id; *p; p++)
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    return h;
+}
+
+settings_index_t *settings_index_get(const settings_group_t *pack)
+{
+    for (settings_index_t *idx = indexes; idx; idx = idx->next) {
+        if (idx->pack == pack)
+            return idx;
+    }
+    return NULL;
+}
+
+const settings_entry_t *settings_index_lookup(const settings_index_t *idx, const char *gr_id, const char *id)
+{
+    uint32_t h = settings_hash(gr_id, id);
+
+    for (size_t i = h & idx->mask; idx->slots[i]; i = (i + 1) & idx->mask) {
+        const settings_entry_t *e = &idx->entries[idx->slots[i] - 1];
+
+        if (e->hash == h && !strcmp(e->group->id, gr_id) && !strcmp(e->setting->id, id))
+            return e;
+    }
+    return NULL;
+}
+
+const settings_entry_t *settings_index_lookup_key(const settings_index_t *idx, const char *key)
+{
+    const char *sep = strchr(key, ':');
+    char        gr_id[64];
+    size_t      n;
+
+    if (!sep || (n = sep - key) >= sizeof(gr_id))
+        return NULL;
+    memcpy(gr_id, key, n);
+    gr_id[n] = '\0';
+    return settings_index_lookup(idx, gr_id, sep + 1);
+}
+
+esp_err_t settings_pack_index(const settings_group_t *settings_pack)
+{
+    settings_index_t *idx;
+    size_t            count = 0;
+    size_t            slots = 1;
+
+    if (!settings_pack)
+        return ESP_ERR_INVALID_ARG;
+
+    if (settings_index_get(settings_pack))
+        return ESP_OK;
+
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++)
+            count++;
+    }
+    if (count >= UINT16_MAX)
+        return ESP_ERR_INVALID_SIZE;
+
+    // at most half full, so probe sequences stay short
+    while (slots < 2 * count)
+        slots <<= 1;
+
+    idx = calloc(1, sizeof(*idx) + count * sizeof(settings_entry_t) + slots * sizeof(uint16_t));
+    if (!idx)
+        return ESP_ERR_NO_MEM;
+
+    idx->pack = settings_pack;
+    idx->entries = (settings_entry_t *)(idx + 1);
+    idx->slots = (uint16_t *)(idx->entries + count);
+    idx->mask = slots - 1;
+
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++) {
+            settings_entry_t *e = &idx->entries[idx->count];
+
+            // like the linear search, the first of duplicate ids wins
+            if (settings_index_lookup(idx, gr->id, setting->id)) {
+                ESP_LOGW(TAG, "duplicate setting %s:%s", gr->id, setting->id);
+                e->setting = setting;
+                e->group = gr;
+                idx->count++;
+                continue;
+            }
+
+            e->setting = setting;
+            e->group = gr;
+            e->hash = settings_hash(gr->id, setting->id);
+
+            size_t i = e->hash & idx->mask;
+            while (idx->slots[i])
+                i = (i + 1) & idx->mask;
+            idx->slots[i] = ++idx->count;
+        }
+    }
+
+    idx->next = indexes;
+    indexes = idx;
+    return ESP_OK;
+}
+
+esp_err_t setting_ref_resolve(const settings_group_t *settings_pack, const char *gr_id, const char *id,
+                              setting_ref_t *ref)
+{
+    const settings_index_t *idx;
+    uint16_t                n = 0;
+
+    if (!settings_pack || !gr_id || !id || !ref)
+        return ESP_ERR_INVALID_ARG;
+
+    idx = settings_index_get(settings_pack);
+    if (idx) {
+        const settings_entry_t *e = settings_index_lookup(idx, gr_id, id);
+
+        if (!e)
+            return ESP_ERR_NOT_FOUND;
+        ref->setting = e->setting;
+        ref->group = e->group;
+        ref->index = e - idx->entries;
+        return ESP_OK;
+    }
+
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        for (setting_t *setting = gr->settings; setting->id; setting++, n++) {
+            if (!strcmp(gr_id, gr->id) && !strcmp(id, setting->id)) {
+                ref->setting = setting;
+                ref->group = gr;
+                ref->index = n;
+                return ESP_OK;
+            }
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t setting_ref_set_bool(const setting_ref_t *ref, bool val)
+{
+    if (!ref || !ref->setting)
+        return ESP_ERR_INVALID_ARG;
+
+    if (ref->setting->type != SETTING_TYPE_BOOL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (ref->setting->boolean.val != val) {
+        ref->setting->boolean.val = val;
+        setting_mark_changed(ref->setting);
+    }
+    return ESP_OK;
+}
+
+esp_err_t setting_ref_set_int(const setting_ref_t *ref, int val)
+{
+    setting_t *setting;
+
+    if (!ref || !ref->setting)
+        return ESP_ERR_INVALID_ARG;
+
+    setting = ref->setting;
+    switch (setting->type) {
+    case SETTING_TYPE_NUM:
+        if (val < setting->num.range[0] || val > setting->num.range[1])
+            return ESP_ERR_INVALID_ARG;
+        if (setting->num.val != val) {
+            setting->num.val = val;
+            setting_mark_changed(setting);
+        }
+        return ESP_OK;
+    case SETTING_TYPE_ONEOF: {
+        int labels_count = 0;
+        for (const char **label = setting->oneof.options; *label != NULL; label++)
+            labels_count++;
+        if (val < 0 || val >= labels_count)
+            return ESP_ERR_INVALID_ARG;
+        if (setting->oneof.val != val) {
+            setting->oneof.val = val;
+            setting_mark_changed(setting);
+        }
+        return ESP_OK;
+    }
+    default:
+        return ESP_ERR_INVALID_STATE;
+    }
+}
+
+esp_err_t setting_ref_set_text(const setting_ref_t *ref, const char *val)
+{
+    setting_t *setting;
+
+    if (!ref || !ref->setting || !val)
+        return ESP_ERR_INVALID_ARG;
+
+    setting = ref->setting;
+    switch (setting->type) {
+    case SETTING_TYPE_TEXT:
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    case SETTING_TYPE_TIMEZONE:
+#endif
+        // TEXT and TIMEZONE share the setting_text_t layout
+        if (strlen(val) >= setting->text.len)
+            return ESP_ERR_INVALID_SIZE;
+        if (strcmp(setting->text.val, val)) {
+            strcpy(setting->text.val, val);
+            setting_mark_changed(setting);
+        }
+        return ESP_OK;
+    default:
+        return ESP_ERR_INVALID_STATE;
+    }
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "settings_priv.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void json_flush(settings_json_t *js)
+{
+    if (!js->req) {
+        // FNV-1a, see settings_json_t
+        for (size_t i = 0; i < js->len; i++)
+            js->hash = (js->hash ^ (uint8_t)js->buf[i]) * 16777619u;
+    } else if (js->len && js->rc == ESP_OK) {
+        js->rc = httpd_resp_send_chunk(js->req, js->buf, js->len);
+    }
+    js->len = 0;
+}
+
+static void json_write(settings_json_t *js, const char *data, size_t len)
+{
+    while (len) {
+        size_t n = sizeof(js->buf) - js->len;
+
+        if (n > len)
+            n = len;
+        memcpy(&js->buf[js->len], data, n);
+        js->len += n;
+        data += n;
+        len -= n;
+        if (js->len == sizeof(js->buf))
+            json_flush(js);
+    }
+}
+
+static void json_putc(settings_json_t *js, char c)
+{
+    json_write(js, &c, 1);
+}
+
+static void json_quoted(settings_json_t *js, const char *s)
+{
+    const char *run = s;
+
+    json_putc(js, '"');
+    for (; *s; s++) {
+        char esc[8];
+        char c = *s;
+
+        if (c != '"' && c != '\\' && (unsigned char)c >= 0x20)
+            continue;
+
+        json_write(js, run, s - run);
+        run = s + 1;
+        switch (c) {
+        case '"':
+        case '\\':
+            esc[0] = '\\';
+            esc[1] = c;
+            json_write(js, esc, 2);
+            break;
+        case '\n':
+            json_write(js, "\\n", 2);
+            break;
+        case '\r':
+            json_write(js, "\\r", 2);
+            break;
+        case '\t':
+            json_write(js, "\\t", 2);
+            break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)c);
+            json_write(js, esc, 6);
+            break;
+        }
+    }
+    json_write(js, run, s - run);
+    json_putc(js, '"');
+}
+
+// separator and key before a value
+static void json_key(settings_json_t *js, const char *key)
+{
+    if (js->comma)
+        json_putc(js, ',');
+    if (key) {
+        json_quoted(js, key);
+        json_putc(js, ':');
+    }
+    js->comma = true;
+}
+
+void settings_json_init(settings_json_t *js, httpd_req_t *req)
+{
+    js->req = req;
+    js->rc = ESP_OK;
+    js->len = 0;
+    js->comma = false;
+    js->hash = 2166136261u;
+    if (req)
+        httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+}
+
+void settings_json_begin_object(settings_json_t *js, const char *key)
+{
+    json_key(js, key);
+    json_putc(js, '{');
+    js->comma = false;
+}
+
+void settings_json_end_object(settings_json_t *js)
+{
+    json_putc(js, '}');
+    js->comma = true;
+}
+
+void settings_json_begin_array(settings_json_t *js, const char *key)
+{
+    json_key(js, key);
+    json_putc(js, '[');
+    js->comma = false;
+}
+
+void settings_json_end_array(settings_json_t *js)
+{
+    json_putc(js, ']');
+    js->comma = true;
+}
+
+void settings_json_add_string(settings_json_t *js, const char *key, const char *val)
+{
+    json_key(js, key);
+    if (val)
+        json_quoted(js, val);
+    else
+        json_write(js, "null", 4);
+}
+
+void settings_json_add_number(settings_json_t *js, const char *key, int val)
+{
+    char num[12];
+
+    json_key(js, key);
+    json_write(js, num, snprintf(num, sizeof(num), "%d", val));
+}
+
+void settings_json_add_bool(settings_json_t *js, const char *key, bool val)
+{
+    json_key(js, key);
+    if (val)
+        json_write(js, "true", 4);
+    else
+        json_write(js, "false", 5);
+}
+
+esp_err_t settings_json_finish(settings_json_t *js)
+{
+    json_flush(js);
+    if (js->req && js->rc == ESP_OK)
+        js->rc = httpd_resp_send_chunk(js->req, NULL, 0);
+    return js->rc;
+}
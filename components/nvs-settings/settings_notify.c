@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "settings_priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct settings_sub {
+    struct settings_sub *next;
+    settings_change_cb_t cb;
+    void                *arg;
+} settings_sub_t;
+
+/*
+ * One subscribed setting: its subscribers and the value they were last told
+ * about. Text values are copied into `text`, `old.text.val` points there.
+ */
+typedef struct settings_watch {
+    struct settings_watch  *next;
+    const settings_group_t *pack;
+    const settings_group_t *group;
+    setting_t              *setting;
+    settings_sub_t         *subs;
+    uint32_t                gen;
+    setting_t               old;
+    char                    text[];
+} settings_watch_t;
+
+static settings_watch_t *watches;
+
+static bool setting_has_text(const setting_t *setting)
+{
+#ifdef CONFIG_SETTINGS_TIMEZONE_SUPPORT
+    if (setting->type == SETTING_TYPE_TIMEZONE)
+        return true;
+#endif
+    return setting->type == SETTING_TYPE_TEXT;
+}
+
+// remember the current value as the one subscribers know
+static void settings_watch_snapshot(settings_watch_t *w)
+{
+    memcpy(&w->old, w->setting, sizeof(setting_t));
+    w->gen = w->setting->gen;
+    // TEXT and TIMEZONE share the setting_text_t layout
+    if (setting_has_text(w->setting)) {
+        strncpy(w->text, w->setting->text.val, w->setting->text.len);
+        w->old.text.val = w->text;
+    }
+}
+
+static settings_watch_t *settings_watch_get(const settings_group_t *settings_pack, const settings_group_t *gr,
+                                            setting_t *setting)
+{
+    settings_watch_t **tail = &watches;
+    settings_watch_t  *w;
+    size_t             text_len = setting_has_text(setting) ? setting->text.len : 0;
+
+    for (; *tail; tail = &(*tail)->next) {
+        if ((*tail)->setting == setting)
+            return *tail;
+    }
+
+    w = calloc(1, sizeof(*w) + text_len);
+    if (!w)
+        return NULL;
+    w->pack = settings_pack;
+    w->group = gr;
+    w->setting = setting;
+    settings_watch_snapshot(w);
+    *tail = w;
+    return w;
+}
+
+static esp_err_t settings_watch_add(const settings_group_t *settings_pack, const settings_group_t *gr,
+                                    setting_t *setting, settings_change_cb_t cb, void *arg)
+{
+    settings_watch_t *w = settings_watch_get(settings_pack, gr, setting);
+    settings_sub_t  **tail;
+
+    if (!w)
+        return ESP_ERR_NO_MEM;
+
+    // subscribers are called in the order they subscribed
+    for (tail = &w->subs; *tail; tail = &(*tail)->next) {
+        if ((*tail)->cb == cb && (*tail)->arg == arg)
+            return ESP_OK;
+    }
+    *tail = calloc(1, sizeof(settings_sub_t));
+    if (!*tail)
+        return ESP_ERR_NO_MEM;
+    (*tail)->cb = cb;
+    (*tail)->arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t settings_subscribe(const settings_group_t *settings_pack, const char *gr_id, const char *id,
+                             settings_change_cb_t cb, void *arg)
+{
+    setting_ref_t ref;
+    esp_err_t     rc;
+
+    if (!settings_pack || !gr_id || !cb)
+        return ESP_ERR_INVALID_ARG;
+
+    if (id) {
+        rc = setting_ref_resolve(settings_pack, gr_id, id, &ref);
+        if (rc != ESP_OK)
+            return rc;
+        return settings_watch_add(settings_pack, ref.group, ref.setting, cb, arg);
+    }
+
+    // a group subscription watches every setting of the group
+    for (const settings_group_t *gr = settings_pack; gr->id; gr++) {
+        if (strcmp(gr->id, gr_id))
+            continue;
+        for (setting_t *setting = gr->settings; setting->id; setting++) {
+            rc = settings_watch_add(settings_pack, gr, setting, cb, arg);
+            if (rc != ESP_OK)
+                return rc;
+        }
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void settings_notify(const settings_group_t *settings_pack)
+{
+    for (settings_watch_t *w = watches; w; w = w->next) {
+        if (w->pack != settings_pack || w->setting->gen == w->gen)
+            continue;
+        for (settings_sub_t *sub = w->subs; sub; sub = sub->next)
+            sub->cb(w->group, w->setting, &w->old, sub->arg);
+        settings_watch_snapshot(w);
+    }
+}
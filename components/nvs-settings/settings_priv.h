@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2025 <qb4.dev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef SETTINGS_PRIV_H_
+#define SETTINGS_PRIV_H_
+
+#include "include/settings.h"
+
+#include <nvs.h>
+
+/* one resolved setting, entries are kept in pack order */
+typedef struct {
+    setting_t              *setting;
+    const settings_group_t *group;
+    uint32_t                hash;
+} settings_entry_t;
+
+/* lookup index of one settings pack, built once by settings_pack_index() */
+typedef struct settings_index {
+    struct settings_index  *next;
+    const settings_group_t *pack;
+    size_t                  count;
+    settings_entry_t       *entries;
+    uint16_t               *slots; /* open addressing: entry index + 1, 0 for an empty slot */
+    size_t                  mask;
+} settings_index_t;
+
+// index of a pack, NULL if settings_pack_index() was not called for it
+settings_index_t *settings_index_get(const settings_group_t *pack);
+
+// entry of gr_id:id, NULL if there is none
+const settings_entry_t *settings_index_lookup(const settings_index_t *idx, const char *gr_id, const char *id);
+
+// entry of a "gr_id:id" key as used in NVS and HTTP requests, NULL if there is none
+const settings_entry_t *settings_index_lookup_key(const settings_index_t *idx, const char *key);
+
+#define SETTINGS_BLOB_VERSION 1
+
+/*
+ * Group blob (CONFIG_SETTINGS_STORAGE_BLOB): this header, then one record per
+ * stored setting: id length (u8), value length (u16), id, value. Records are
+ * matched by id, so settings can be added, removed or reordered between
+ * firmware versions; values with an unexpected length are skipped.
+ */
+typedef struct {
+    uint8_t  version;
+    uint8_t  reserved;
+    uint16_t count;
+} settings_blob_hdr_t;
+
+// read the blob of a group, ESP_ERR_NVS_NOT_FOUND if the group has none
+esp_err_t settings_blob_read(nvs_handle nvs, const settings_group_t *gr);
+
+// store all settings of a group as one blob keyed by the group id
+esp_err_t settings_blob_write(nvs_handle nvs, const settings_group_t *gr);
+
+#ifndef CONFIG_SETTINGS_JSON_CHUNK_SIZE
+#define CONFIG_SETTINGS_JSON_CHUNK_SIZE 256
+#endif
+
+/*
+ * Compact JSON streamed out with httpd_resp_send_chunk() through a fixed
+ * buffer, so a response needs the same memory whatever the pack size.
+ * `key` is NULL for array elements. After a send error the rest is dropped
+ * and settings_json_finish() returns the error. A writer initialized without
+ * a request sends nothing and only hashes the output into `hash`.
+ */
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t    rc;
+    size_t       len;
+    bool         comma;
+    uint32_t     hash;
+    char         buf[CONFIG_SETTINGS_JSON_CHUNK_SIZE];
+} settings_json_t;
+
+void      settings_json_init(settings_json_t *js, httpd_req_t *req);
+void      settings_json_begin_object(settings_json_t *js, const char *key);
+void      settings_json_end_object(settings_json_t *js);
+void      settings_json_begin_array(settings_json_t *js, const char *key);
+void      settings_json_end_array(settings_json_t *js);
+void      settings_json_add_string(settings_json_t *js, const char *key, const char *val);
+void      settings_json_add_number(settings_json_t *js, const char *key, int val);
+void      settings_json_add_bool(settings_json_t *js, const char *key, bool val);
+esp_err_t settings_json_finish(settings_json_t *js);
+
+/* called once per decoded key=value pair of a form */
+typedef void (*settings_form_cb_t)(const char *key, const char *value, void *arg);
+
+/*
+ * Parse an application/x-www-form-urlencoded request body in one pass,
+ * reading it in fixed chunks. Keys and values are percent-decoded; pairs
+ * with a key or value too long for the internal buffers are skipped.
+ */
+esp_err_t settings_form_parse(httpd_req_t *req, settings_form_cb_t cb, void *arg);
+
+#endif /* SETTINGS_PRIV_H_ */
@@ -0,0 +1,119 @@
+/*
+ * Host benchmark of settings lookups: settings_pack_find() by linear scan,
+ * the same call once settings_pack_index() has built the hashed index, and
+ * a get plus a set through a setting_ref_t handle.
+ *
+ * Packs of 10, 100 and 1000 number settings are looked up one setting after
+ * the other. The indexed results are checked against the linear scan first.
+ * Times are for the host CPU.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "settings.h"
+
+#define LOOKUPS 2000000 /* per measurement, spread over the whole pack */
+
+typedef struct {
+    int groups;
+    int per_group;
+} pack_size_t;
+
+static const pack_size_t sizes[] = { { 2, 5 }, { 10, 10 }, { 20, 50 } };
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static settings_group_t *pack_create(int groups, int per_group)
+{
+    settings_group_t *pack = calloc(groups + 1, sizeof(*pack));
+
+    for (int g = 0; g < groups; g++) {
+        char *id = malloc(16);
+
+        snprintf(id, 16, "G%d", g);
+        pack[g].id = pack[g].label = id;
+        pack[g].settings = calloc(per_group + 1, sizeof(setting_t));
+        for (int i = 0; i < per_group; i++) {
+            setting_t *s = &pack[g].settings[i];
+
+            id = malloc(16);
+            snprintf(id, 16, "SET%d", i);
+            s->id = s->label = id;
+            s->type = SETTING_TYPE_NUM;
+            s->num.val = g * per_group + i;
+            s->num.range[1] = 1 << 30;
+        }
+    }
+    return pack;
+}
+
+// ns per lookup of every setting of the pack in turn
+static double time_find(const settings_group_t *pack, int rounds, volatile long *sink)
+{
+    double t0 = now_ns();
+    int    n = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        for (const settings_group_t *gr = pack; gr->id; gr++) {
+            for (const setting_t *s = gr->settings; s->id; s++, n++)
+                *sink += settings_pack_find(pack, gr->id, s->id)->num.val;
+        }
+    }
+    return (now_ns() - t0) / n;
+}
+
+static int run(const pack_size_t *size)
+{
+    int               count = size->groups * size->per_group;
+    int               rounds = LOOKUPS / count;
+    settings_group_t *pack = pack_create(size->groups, size->per_group);
+    setting_ref_t    *refs = calloc(count, sizeof(*refs));
+    volatile long     sink = 0;
+    int               failed = 0;
+
+    double linear = time_find(pack, rounds, &sink);
+
+    settings_pack_index(pack);
+    for (int g = 0, k = 0; g < size->groups; g++) {
+        for (int i = 0; i < size->per_group; i++, k++) {
+            const char *gr_id = pack[g].id, *id = pack[g].settings[i].id;
+
+            setting_ref_resolve(pack, gr_id, id, &refs[k]);
+            if (settings_pack_find(pack, gr_id, id) != &pack[g].settings[i] ||
+                refs[k].setting != &pack[g].settings[i] || refs[k].index != k) {
+                printf("%s:%s resolves to the wrong setting\n", gr_id, id);
+                failed++;
+            }
+        }
+    }
+
+    double indexed = time_find(pack, rounds, &sink);
+
+    double t0 = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < count; k++)
+            setting_ref_set_int(&refs[k], setting_ref_get_int(&refs[k]) + 1);
+    }
+    double ref = (now_ns() - t0) / ((double)rounds * count);
+
+    printf("%5d %12.1f %12.1f %12.1f\n", count, linear, indexed, ref);
+    return failed;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    printf("%5s %12s %12s %12s\n", "n", "linear find", "index find", "ref get+set");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        failed += run(&sizes[i]);
+    printf("(ns per lookup)\n");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
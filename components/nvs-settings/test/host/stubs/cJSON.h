@@ -0,0 +1,22 @@
+/* Declarations only, for host builds, see ../Makefile */
+#pragma once
+
+typedef struct cJSON {
+    struct cJSON *next, *prev, *child;
+    int           type;
+    char         *valuestring;
+    int           valueint;
+    double        valuedouble;
+    char         *string;
+} cJSON;
+
+#define cJSON_ArrayForEach(e, a) for (e = (a) ? (a)->child : NULL; e; e = e->next)
+
+cJSON *cJSON_Parse(const char *value);
+void   cJSON_Delete(cJSON *item);
+int    cJSON_GetArraySize(const cJSON *array);
+int    cJSON_IsBool(const cJSON *item);
+int    cJSON_IsTrue(const cJSON *item);
+int    cJSON_IsNumber(const cJSON *item);
+int    cJSON_IsString(const cJSON *item);
+int    cJSON_IsObject(const cJSON *item);
@@ -0,0 +1,40 @@
+/* Declarations only, for host builds, see ../Makefile. The benchmark never serves a request. */
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef void *httpd_handle_t;
+typedef enum { HTTP_GET = 1, HTTP_POST = 3, HTTP_PATCH = 28 } httpd_method_t;
+typedef enum { HTTPD_400_BAD_REQUEST, HTTPD_404_NOT_FOUND, HTTPD_500_INTERNAL_SERVER_ERROR } httpd_err_code_t;
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int            method;
+    const char     uri[513];
+    size_t         content_len;
+    void          *aux;
+    void          *user_ctx;
+} httpd_req_t;
+
+#define HTTPD_TYPE_JSON        "application/json"
+#define HTTPD_TYPE_TEXT        "text/html"
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+#define HTTPD_200              "200 OK"
+#define HTTPD_204              "204 No Content"
+#define HTTPD_400              "400 Bad Request"
+#define HTTPD_500              "500 Internal Server Error"
+
+int       httpd_req_recv(httpd_req_t *r, char *buf, size_t len);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t len);
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+esp_err_t httpd_resp_send_err(httpd_req_t *r, httpd_err_code_t error, const char *msg);
+size_t    httpd_req_get_url_query_len(httpd_req_t *r);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t len);
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t len);
+size_t    httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t len);
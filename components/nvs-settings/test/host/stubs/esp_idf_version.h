@@ -0,0 +1,5 @@
+/* Minimal esp_idf_version.h for host builds, see ../Makefile */
+#pragma once
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION                          ESP_IDF_VERSION_VAL(5, 1, 0)
@@ -0,0 +1,14 @@
+/* Minimal esp_log.h for host builds, see ../Makefile */
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#define ESP_HOST_LOG(l, tag, fmt, ...) fprintf(stderr, l " (%s) " fmt "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, fmt, ...) ESP_HOST_LOG("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_HOST_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_HOST_LOG("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) ((void)(tag))
+#define ESP_LOGV(tag, fmt, ...) ((void)(tag))
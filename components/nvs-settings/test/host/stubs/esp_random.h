@@ -0,0 +1,6 @@
+/* Declarations only, for host builds, see ../Makefile */
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
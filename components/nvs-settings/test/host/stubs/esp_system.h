@@ -0,0 +1,4 @@
+/* Declarations only, for host builds, see ../Makefile */
+#pragma once
+
+void esp_restart(void);
@@ -0,0 +1,7 @@
+/* Declarations only, for host builds, see ../Makefile */
+#pragma once
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -142,22 +142,23 @@ static esp_err_t on_settings_changed(const settings_group_t *settings, void *arg
 {
     ESP_LOGI(TAG, "settings changed");
     settings_pack_print(app_settings);
+    return ESP_OK;
+}
 
-    /* example usage of setting */
-    setting_t *dispbr_setting = settings_pack_find(settings, GROUP_DEVICE_ID, "DISPBR");
-    uint8_t    brightness = dispbr_setting ? dispbr_setting->num.val : 7;
-    ESP_LOGW(TAG, "-> set display brightness to %d", brightness);
+/* subscribers are only called for the setting they watch, with its previous value */
+static void on_brightness_changed(const settings_group_t *group, const setting_t *setting, const setting_t *old,
+                                  void *arg)
+{
+    ESP_LOGW(TAG, "-> set display brightness %d -> %d", old->num.val, setting->num.val);
+}
 
-    /* example: read LED color if available */
 #ifdef CONFIG_SETTINGS_COLOR_SUPPORT
-    setting_t *ledclr = settings_pack_find(settings, GROUP_DEVICE_ID, "LEDCLR");
-    if (ledclr) {
-        ESP_LOGW(TAG, "-> LED color: 0x%06" PRIx32, ledclr->color.combined);
-    }
-#endif
-
-    return ESP_OK;
+static void on_led_color_changed(const settings_group_t *group, const setting_t *setting, const setting_t *old,
+                                 void *arg)
+{
+    ESP_LOGW(TAG, "-> LED color: 0x%06" PRIx32, setting->color.combined);
 }
+#endif
 
 void app_main(void)
 {
@@ -172,6 +173,10 @@ void app_main(void)
     settings_nvs_read(app_settings);
     settings_pack_print(app_settings);
     settings_handler_register(on_settings_changed, NULL);
+    settings_subscribe(app_settings, GROUP_DEVICE_ID, "DISPBR", on_brightness_changed, NULL);
+#ifdef CONFIG_SETTINGS_COLOR_SUPPORT
+    settings_subscribe(app_settings, GROUP_DEVICE_ID, "LEDCLR", on_led_color_changed, NULL);
+#endif
 
     ESP_LOGI(TAG, "Starting webserver + WiFi (APSTA)");
     ESP_ERROR_CHECK(webserver_init(app_settings));
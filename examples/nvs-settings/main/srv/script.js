@@ -43,51 +43,52 @@ function getSettingsForm(){
 		"Europe/Moscow"
 	];
 
-	fetch(esp_url+"/settings")
+	// the schema only changes with the firmware, the browser keeps it cached by its hash
+	fetch(esp_url+"/settings/values")
 	.then(r => r.json())
+	.then(vals => fetch(esp_url+"/settings/schema?h="+vals.schema)
+		.then(r => r.json())
+		.then(schema => ({ groups: schema.groups, data: vals.data })))
 	.then(js => {
 		const div = document.getElementById('brd');
 
 		let html = `<form id="brd-form" method="post">`;
-		js.data.groups.forEach((gr, i) => {
+		js.groups.forEach((gr, i) => {
 			html+=`${gr.label}:<br>`;
 			html+='<small>';
 			gr.settings.forEach((item, i) => {
+				const val = js.data[`${gr.id}:${item.id}`];
 				switch (item.type) {
 					case "BOOL":
-						html+=`<input type="checkbox" name="${gr.id}:${item.id}" ${item.val?"checked":''}>${item.label}<br>`;
+						html+=`<input type="checkbox" name="${gr.id}:${item.id}" ${val?"checked":''}>${item.label}<br>`;
 						break;
 					case "NUM":
-						html+=`<span class="label-inline">${item.label}</span><input type="number" name="${gr.id}:${item.id}" min=${item.min} max=${item.max} value=${item.val} style="width:250px"><br>`;
+						html+=`<span class="label-inline">${item.label}</span><input type="number" name="${gr.id}:${item.id}" min=${item.min} max=${item.max} value=${val} style="width:250px"><br>`;
 						break;
 					case "ONEOF":
 						html+=`<span class="label-inline">${item.label}</span><select name="${gr.id}:${item.id}" style="width:160px">`;
-						item.options.forEach((txt, i) => { html+=` <option value=${i} ${item.val==i?"selected":''}>${txt}</option>`;});
+						item.options.forEach((txt, i) => { html+=` <option value=${i} ${val==i?"selected":''}>${txt}</option>`;});
 						html+=`</select><br>`;
 						break;
 					case "TEXT":
-						html+=`<span class="label-inline">${item.label}</span><input type="text" name="${gr.id}:${item.id}" value="${item.val}" maxlength="${item.len}" style="width:250px"><br>`;
+						html+=`<span class="label-inline">${item.label}</span><input type="text" name="${gr.id}:${item.id}" value="${val}" maxlength="${item.len}" style="width:250px"><br>`;
 						break;
 					case "TIME":
-						let time = String(item.hh).padStart(2,'0')+":"+String(item.mm).padStart(2,'0');
-						html+=`<span class="label-inline">${item.label}</span><input type="time" name="${gr.id}:${item.id}" min="00:00" max="23:59" value="${time}" style="width:250px"/><br>`;
+						html+=`<span class="label-inline">${item.label}</span><input type="time" name="${gr.id}:${item.id}" min="00:00" max="23:59" value="${val}" style="width:250px"/><br>`;
 						break;
                       case "DATE":
-                        let date = String(item.year).padStart(4,'0')+"-"+String(item.month).padStart(2,'0')+"-"+String(item.day).padStart(2,'0');
-                        html+=`<span class="label-inline">${item.label}</span><input type="date" name="${gr.id}:${item.id}"  value="${date}" style="width:250px"/><br>`;
+                        html+=`<span class="label-inline">${item.label}</span><input type="date" name="${gr.id}:${item.id}"  value="${val}" style="width:250px"/><br>`;
                         break;
                       case "DATETIME":
-                        let datetime = String(item.year).padStart(4,'0')+"-"+String(item.month).padStart(2,'0')+"-"+String(item.day).padStart(2,'0');
-                        datetime+="T"+String(item.hh).padStart(2,'0')+":"+String(item.mm).padStart(2,'0');
-                        html+=`<span class="label-inline">${item.label}</span><input type="datetime-local" name="${gr.id}:${item.id}"  value="${datetime}" style="width:250px"/><br>`;
+                        html+=`<span class="label-inline">${item.label}</span><input type="datetime-local" name="${gr.id}:${item.id}"  value="${val}" style="width:250px"/><br>`;
                         break;
                       case "TIMEZONE":
                         html+=`<span class="label-inline">${item.label}</span><select name="${gr.id}:${item.id}" style="width:250px">`;
-                        tzlist.forEach((txt, i) => { html+=`<option value="${txt}" ${item.val==txt?"selected":''}>${txt}</option>`;});
+                        tzlist.forEach((txt, i) => { html+=`<option value="${txt}" ${val==txt?"selected":''}>${txt}</option>`;});
                         html+=`</select><br>`;
                         break;
 					case "COLOR":
-						html+=`<span class="label-inline">${item.label}</span><input type="color" name="${gr.id}:${item.id}" value="${item.val}" style="width:50px"/><br>`;
+						html+=`<span class="label-inline">${item.label}</span><input type="color" name="${gr.id}:${item.id}" value="${val}" style="width:50px"/><br>`;
 						break;
 					default:
 						break;
@@ -104,7 +105,7 @@ function getSettingsForm(){
 		const form = document.getElementById('brd-form');
 		form.onsubmit = function(e){
 			e.preventDefault();
-			let data = decodeURIComponent(new URLSearchParams(new FormData(this)));
+			let data = new URLSearchParams(new FormData(this));
 			fetch(esp_url+"/settings?action=set",
 			{
 				method: "POST",